@@ -0,0 +1,118 @@
+///
+// alloc_hook.cpp
+//
+// Replacements for every form of the global operator new and delete which
+// count allocations before forwarding to malloc and free.
+
+#include <cstdlib>
+#include <new>
+
+#include "bench/alloc_hook.hpp"
+
+namespace {
+
+// Counts of the current thread. These are trivially initialised, so reading
+// them never allocates.
+thread_local bench::alloc_counts counts = {0, 0};
+
+void* allocate(const std::size_t size)
+{
+    counts.allocations += 1;
+    counts.bytes += size;
+    return std::malloc(size ? size : 1);
+}
+
+void* allocate_aligned(const std::size_t size, const std::align_val_t align)
+{
+    counts.allocations += 1;
+    counts.bytes += size;
+
+    // aligned_alloc requires the size to be a multiple of the alignment
+    const std::size_t a = static_cast<std::size_t>(align);
+    return std::aligned_alloc(a, ((size ? size : 1) + a - 1) / a * a);
+}
+
+} // anonymous namespace
+
+namespace bench {
+
+alloc_counts thread_allocations()
+{
+    return counts;
+}
+
+} // namespace bench
+
+void* operator new(const std::size_t size)
+{
+    if (void *p = allocate(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t align)
+{
+    if (void *p = allocate_aligned(size, align))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t align)
+{
+    return operator new(size, align);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
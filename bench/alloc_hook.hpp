@@ -0,0 +1,27 @@
+///
+// alloc_hook.hpp
+//
+// Counts heap allocations by replacing the global operator new and delete.
+// Linking alloc_hook.cpp into a program installs the hook; without it these
+// functions are not defined.
+//
+// Counts are kept per thread, so they can be read around a single call
+// without interference from (or contention with) other threads.
+
+#pragma once
+
+#include <cstdint>
+
+namespace bench {
+
+// Allocations made through operator new
+struct alloc_counts
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+// Return the allocations made by the calling thread since it started.
+alloc_counts thread_allocations();
+
+} // namespace bench
@@ -0,0 +1,289 @@
+///
+// bench.hpp
+//
+// A small harness for repeatable micro-benchmarks.
+//
+// Each benchmark is first calibrated to find a batch size which takes about
+// c_sample_ns, then run for a number of untimed warm-up batches so that caches,
+// branch predictors and the cpu clock settle. The reported time is the median
+// ns/op over the timed batches, along with the median absolute deviation as a
+// measure of stability. Results whose deviation is above c_max_spread are
+// flagged, since they are not trustworthy enough to compare across commits.
+//
+// A table is printed as each benchmark completes, and all results can also be
+// written as JSON (--json=PATH) for tracking regressions.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+typedef std::chrono::steady_clock clock_type;
+
+// Target duration of a single timed batch
+static constexpr int64_t c_sample_ns = 10 * 1000 * 1000;
+
+// Batches run before timing begins
+static constexpr int c_warmup_samples = 5;
+
+// Timed batches per benchmark, unless overridden with --samples
+static constexpr int c_default_samples = 31;
+
+// Relative deviation above which a result is marked as unstable
+static constexpr double c_max_spread = 0.05;
+
+// Number of copies of the state kept by run_fresh
+static constexpr int c_fresh_copies = 64;
+
+// Prevent the compiler from optimising away the computation of a value.
+template <typename T>
+inline void keep(T &&value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Return the nanoseconds elapsed since start.
+inline int64_t elapsed_ns(const clock_type::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        clock_type::now() - start).count();
+}
+
+// The timing of a single benchmark, in nanoseconds per operation
+struct result
+{
+    std::string name;
+    int64_t iterations;
+    int samples;
+    double median;
+    double mad;
+    double min;
+    double max;
+
+    // Is the deviation small enough for the result to be compared?
+    bool stable() const
+    {
+        return mad <= median * c_max_spread;
+    }
+};
+
+class suite
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    // Parse the command line. Unknown options print usage and exit.
+    suite(int argc, char **argv) :
+        json_path(nullptr), label(""), samples(c_default_samples)
+    {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strncmp(argv[i], "--filter=", 9) == 0)
+                filters.push_back(argv[i] + 9);
+            else if (std::strncmp(argv[i], "--json=", 7) == 0)
+                json_path = argv[i] + 7;
+            else if (std::strncmp(argv[i], "--label=", 8) == 0)
+                label = argv[i] + 8;
+            else if (std::strncmp(argv[i], "--samples=", 10) == 0)
+                samples = std::max(1, std::atoi(argv[i] + 10));
+            else
+                usage(argv[0]);
+        }
+
+        std::printf("%-44s %12s %8s %14s\n", "benchmark", "ns/op", "+/-",
+                "iterations");
+    }
+
+    // Time a benchmark, where op performs a single operation.
+    template <typename F>
+    void run(const char *name, F op)
+    {
+        run_timed(name, [&op](const int64_t n) {
+            const auto start = clock_type::now();
+            for (int64_t i = 0; i < n; ++i)
+                op();
+            return elapsed_ns(start);
+        });
+    }
+
+    // Time a benchmark whose operation modifies its state, where op performs
+    // a single operation on a copy of state. The copies are restored outside
+    // of the timed region.
+    template <typename T, typename F>
+    void run_fresh(const char *name, const T &state, F op)
+    {
+        std::vector<T> copies(c_fresh_copies, state);
+
+        run_timed(name, [&](const int64_t n) {
+            int64_t total = 0;
+
+            for (int64_t done = 0; done < n; ) {
+                const int64_t k = std::min<int64_t>(n - done, copies.size());
+                for (int64_t i = 0; i < k; ++i)
+                    copies[i] = state;
+
+                const auto start = clock_type::now();
+                for (int64_t i = 0; i < k; ++i)
+                    op(copies[i]);
+                total += elapsed_ns(start);
+                done += k;
+            }
+
+            return total;
+        });
+    }
+
+    // Time a benchmark which measures itself, where batch performs n
+    // operations and returns the nanoseconds they took. This allows any
+    // setup to be excluded from the measurement.
+    template <typename F>
+    void run_timed(const char *name, F batch)
+    {
+        if (!selected(name))
+            return;
+
+        // Grow the batch until it is long enough to scale from reliably
+        int64_t n = 1;
+        int64_t t = batch(n);
+        while (t < c_sample_ns / 100) {
+            n *= 10;
+            t = batch(n);
+        }
+        n = scale(n, t);
+
+        // Rescale once warm, since the first batches are usually the slowest
+        for (int i = 0; i < c_warmup_samples; ++i)
+            t = batch(n);
+        n = scale(n, t);
+
+        std::vector<double> times(samples);
+        for (double &time : times)
+            time = double(batch(n)) / n;
+
+        results.push_back(summarise(name, n, times));
+        print(results.back());
+    }
+
+    // Write the JSON output if requested. Returns the exit status.
+    int finish() const
+    {
+        if (!json_path)
+            return 0;
+
+        FILE *fd = std::fopen(json_path, "w");
+        if (!fd) {
+            std::perror("Error opening benchmark output");
+            return 1;
+        }
+
+        std::fprintf(fd, "{\"label\":\"%s\",\"benchmarks\":[", label);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const result &r = results[i];
+            std::fprintf(fd, "%s\n{\"name\":\"%s\",\"ns_per_op\":%.3f,"
+                    "\"mad\":%.3f,\"min\":%.3f,\"max\":%.3f,"
+                    "\"iterations\":%lld,\"samples\":%d,\"stable\":%s}",
+                    i ? "," : "", r.name.c_str(), r.median, r.mad, r.min,
+                    r.max, (long long) r.iterations, r.samples,
+                    r.stable() ? "true" : "false");
+        }
+        std::fprintf(fd, "\n]}\n");
+
+        return std::fclose(fd) == 0 ? 0 : 1;
+    }
+
+  private:
+    [[noreturn]] static void usage(const char *program)
+    {
+        std::fprintf(stderr, "usage: %s [--filter=TEXT]... [--json=PATH] "
+                "[--label=TEXT] [--samples=N]\n", program);
+        std::exit(2);
+    }
+
+    // Return whether the benchmark matches any of the filters given.
+    bool selected(const char *name) const
+    {
+        if (filters.empty())
+            return true;
+
+        for (const char *filter : filters) {
+            if (std::strstr(name, filter))
+                return true;
+        }
+
+        return false;
+    }
+
+    // Return the batch size which would take c_sample_ns, given that a batch
+    // of n took t nanoseconds.
+    static int64_t scale(const int64_t n, const int64_t t)
+    {
+        return std::max<int64_t>(1, double(n) * c_sample_ns /
+                                    std::max<int64_t>(t, 1));
+    }
+
+    // Return the median of the given values, reordering them.
+    static double median(std::vector<double> &values)
+    {
+        std::sort(values.begin(), values.end());
+        const size_t mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] :
+               (values[mid - 1] + values[mid]) / 2;
+    }
+
+    static result summarise(const char *name, const int64_t n,
+                            std::vector<double> times)
+    {
+        result r;
+        r.name = name;
+        r.iterations = n;
+        r.samples = times.size();
+        r.median = median(times);
+        r.min = times.front();
+        r.max = times.back();
+
+        for (double &time : times)
+            time = std::abs(time - r.median);
+        r.mad = median(times);
+
+        return r;
+    }
+
+    static void print(const result &r)
+    {
+        std::printf("%-44s %12.2f %7.1f%% %14lld%s\n", r.name.c_str(),
+                r.median, r.median ? 100 * r.mad / r.median : 0.0,
+                (long long) r.iterations, r.stable() ? "" : "  (unstable)");
+        std::fflush(stdout);
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Only benchmarks containing one of these are run, if any are given
+    std::vector<const char*> filters;
+
+    // Path of the JSON output, if any
+    const char *json_path;
+
+    // Identifies the run in the JSON output, such as a commit hash
+    const char *label;
+
+    // Timed batches per benchmark
+    int samples;
+
+    // Completed benchmarks
+    std::vector<result> results;
+};
+
+} // namespace bench
@@ -0,0 +1,115 @@
+///
+// games.hpp
+//
+// Helpers for playing whole games headlessly in benchmarks. Games played by
+// the reference bot can be recorded as timestamped key events and replayed,
+// which drives the engine exactly as live input does without the cost of the
+// bot's search.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mpe/ai/bot.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/keystate.hpp"
+#include "mpe/option.hpp"
+
+namespace bench {
+
+// The key events of a recorded game
+struct recording
+{
+    std::vector<mpe::key_event> events;
+};
+
+// Return the time in microseconds at which the given tick is scheduled.
+inline int64_t tick_us(const mpe::option &option, const int64_t tick)
+{
+    return tick * mpe::c_microseconds / option.tickrate;
+}
+
+// Play a game with the reference bot, recording its inputs as key events.
+inline recording record_bot_game(const mpe::option &option)
+{
+    mpe::engine engine(option);
+    mpe::ai::bot bot;
+    recording game;
+
+    while (engine.running) {
+        const auto down = engine.keystate.down;
+        bot.update(engine);
+
+        // Key up and down events within the tick are in the order the bot
+        // makes them. A key pushed since the last update is still pending.
+        const int64_t now = tick_us(option, engine.ticks);
+        for (int i = 0; i < mpe::keycode_length; ++i) {
+            const mpe::keycode key = static_cast<mpe::keycode>(i);
+            const bool pushed = engine.keystate.pending[i];
+            const bool held = engine.keystate.down[i];
+
+            if (down[i] && (!held || pushed))
+                game.events.push_back({now, key, false});
+            if (pushed)
+                game.events.push_back({now, key, true});
+            if (pushed && !held)
+                game.events.push_back({now, key, false});
+        }
+
+        engine.update();
+    }
+
+    return game;
+}
+
+// A recorded game being played back. Events are queued as live input would
+// arrive, only once they are due, so the engine's queue stays as short as it
+// is in a live game.
+class playback
+{
+  public:
+    playback(const mpe::option &option, const recording &game) :
+        option(option), game(game)
+    {
+        restart();
+    }
+
+    // Start the game again from the beginning.
+    void restart()
+    {
+        engine = std::make_unique<mpe::engine>(option);
+        next = 0;
+    }
+
+    // Queue the events due by the next tick, returning the time of the tick.
+    // This is done outside of any measured region, as events arrive from
+    // another thread in a live game.
+    int64_t feed()
+    {
+        const int64_t now = tick_us(option, engine->ticks);
+        for (; next < game.events.size() && game.events[next].time <= now;
+                ++next) {
+            engine->push_event(game.events[next]);
+        }
+
+        return now;
+    }
+
+    // The engine playing the game
+    std::unique_ptr<mpe::engine> engine;
+
+  private:
+    // Options the game was recorded with
+    const mpe::option option;
+
+    // The game being played back
+    const recording &game;
+
+    // Index of the next event to queue
+    size_t next;
+};
+
+} // namespace bench
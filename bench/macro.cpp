@@ -0,0 +1,307 @@
+///
+// macro.cpp
+//
+// Plays a fixed corpus of seeded games headlessly and reports the throughput
+// of each kind of game, the allocations made by each engine update and the
+// peak memory use. The corpus is played on a single thread and then on every
+// core at once, with each thread playing its own copy of the corpus on its
+// own engines. Throughput is measured over the whole game, including engine
+// construction and (for bot games) the bot's search. A drop in per-thread
+// throughput when scaled points to contention or false sharing between
+// engines.
+//
+// The corpus contains three kinds of game:
+//  - random: keys pressed and released at random for a fixed number of ticks
+//  - bot: played live by the reference bot, including its search
+//  - replay: bot games recorded up front and fed back in as key events, each
+//    queued just before the tick it is due
+//
+// There is no corpus of recorded human games, so the replays stand in for
+// human input. They exercise the same event path as a keyboard, but with
+// finesse-optimal timing rather than a player's hesitations and misdrops.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+#include "bench/alloc_hook.hpp"
+#include "bench/games.hpp"
+#include "mpe/ai/bot.hpp"
+#include "mpe/engine.hpp"
+
+// Games of each kind in the corpus, unless overridden with --seeds
+static constexpr int c_default_seeds = 3;
+
+// Shortest time spent playing each kind of game. The corpus is played again
+// until this has passed, so that short games are still measured reliably.
+static constexpr std::chrono::milliseconds c_min_time(500);
+
+// Length of a random game. Random input never finishes a line race.
+static constexpr int64_t c_random_ticks = 2 * 60 * 60;
+
+// One in this many ticks of a random game changes the state of a key
+static constexpr unsigned c_random_press = 4;
+
+// Keys used by random games
+static constexpr mpe::keycode c_random_keys[] = {
+    mpe::keycode::left, mpe::keycode::right, mpe::keycode::down,
+    mpe::keycode::z, mpe::keycode::x, mpe::keycode::c, mpe::keycode::space
+};
+
+enum game_kind {
+    kind_random,
+    kind_bot,
+    kind_replay,
+    kind_length,
+};
+
+static const char *c_kind_names[kind_length] = {"random", "bot", "replay"};
+
+// Work done by a thread while playing games
+struct totals
+{
+    int64_t games;
+    int64_t ticks;
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+// The results of playing one kind of game on a number of threads
+struct result
+{
+    game_kind kind;
+    int threads;
+    double seconds;
+    totals work;
+};
+
+// Update the engine, counting the allocations made by the update.
+static void update(mpe::engine &engine, const int64_t now, totals &t)
+{
+    const bench::alloc_counts before = bench::thread_allocations();
+    engine.update(now);
+    const bench::alloc_counts after = bench::thread_allocations();
+
+    t.allocations += after.allocations - before.allocations;
+    t.bytes += after.bytes - before.bytes;
+    t.ticks += 1;
+}
+
+static void play_random(const mpe::option &option, totals &t)
+{
+    mpe::engine engine(option);
+    std::mt19937 generator(option.seed);
+    std::uniform_int_distribution<int> key(0, std::size(c_random_keys) - 1);
+
+    while (engine.running && engine.ticks < c_random_ticks) {
+        const int64_t now = bench::tick_us(option, engine.ticks);
+
+        // Toggle a key, so that keys are held for random lengths of time
+        if (generator() % c_random_press == 0) {
+            const mpe::keycode k = c_random_keys[key(generator)];
+            engine.push_event({now, k, !engine.keystate.down[k]});
+        }
+
+        update(engine, now, t);
+    }
+}
+
+static void play_bot(const mpe::option &option, totals &t)
+{
+    mpe::engine engine(option);
+    mpe::ai::bot bot;
+
+    while (engine.running) {
+        bot.update(engine);
+        update(engine, bench::tick_us(option, engine.ticks), t);
+    }
+}
+
+static void play_replay(const mpe::option &option,
+                        const bench::recording &game, totals &t)
+{
+    bench::playback replay(option, game);
+
+    while (replay.engine->running) {
+        const int64_t now = replay.feed();
+        update(*replay.engine, now, t);
+    }
+}
+
+// Play every game of the given kind in the corpus, repeating it until at
+// least c_min_time has passed.
+static totals play_corpus(const game_kind kind, const int seeds,
+                          const std::vector<bench::recording> &recordings)
+{
+    totals t = {0, 0, 0, 0};
+    const auto end = std::chrono::steady_clock::now() + c_min_time;
+
+    do {
+        for (int i = 0; i < seeds; ++i) {
+            mpe::option option;
+            option.seed = i + 1;
+
+            switch (kind) {
+              case kind_random:
+                play_random(option, t);
+                break;
+              case kind_bot:
+                play_bot(option, t);
+                break;
+              case kind_replay:
+                play_replay(option, recordings[i], t);
+                break;
+              default:
+                break;
+            }
+
+            t.games += 1;
+        }
+    } while (std::chrono::steady_clock::now() < end);
+
+    return t;
+}
+
+// Play the corpus of the given kind on each of n threads at once.
+static result run(const game_kind kind, const int n, const int seeds,
+                  const std::vector<bench::recording> &recordings)
+{
+    std::vector<totals> work(n);
+    std::vector<std::thread> threads;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            work[i] = play_corpus(kind, seeds, recordings);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    result r = {kind, n, elapsed.count(), {0, 0, 0, 0}};
+    for (const totals &t : work) {
+        r.work.games += t.games;
+        r.work.ticks += t.ticks;
+        r.work.allocations += t.allocations;
+        r.work.bytes += t.bytes;
+    }
+
+    return r;
+}
+
+// Return the peak resident set size of the process in kilobytes.
+static long peak_rss_kb()
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+static void print(const result &r, const result &single)
+{
+    const double ticks = std::max<int64_t>(r.work.ticks, 1);
+
+    // Per-thread throughput relative to a single thread
+    const double scaling = r.work.ticks / r.seconds / r.threads /
+                           (single.work.ticks / single.seconds);
+
+    std::printf("%-8s %7d %10.2f %12.0f %10.3f %10.1f %9.1f%%\n",
+            c_kind_names[r.kind], r.threads, r.work.games / r.seconds,
+            r.work.ticks / r.seconds, r.work.allocations / ticks,
+            r.work.bytes / ticks, 100 * scaling);
+    std::fflush(stdout);
+}
+
+static void write_json(const char *path, const char *label,
+                       const std::vector<result> &results, const long rss)
+{
+    FILE *fd = std::fopen(path, "w");
+    if (!fd) {
+        std::perror("Error opening benchmark output");
+        return;
+    }
+
+    std::fprintf(fd, "{\"label\":\"%s\",\"peak_rss_kb\":%ld,\"games\":[",
+            label, rss);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result &r = results[i];
+        const double ticks = std::max<int64_t>(r.work.ticks, 1);
+
+        std::fprintf(fd, "%s\n{\"kind\":\"%s\",\"threads\":%d,"
+                "\"games\":%lld,\"ticks\":%lld,\"seconds\":%.6f,"
+                "\"games_per_sec\":%.3f,\"ticks_per_sec\":%.1f,"
+                "\"allocations_per_tick\":%.4f,\"bytes_per_tick\":%.2f}",
+                i ? "," : "", c_kind_names[r.kind], r.threads,
+                (long long) r.work.games, (long long) r.work.ticks,
+                r.seconds, r.work.games / r.seconds,
+                r.work.ticks / r.seconds, r.work.allocations / ticks,
+                r.work.bytes / ticks);
+    }
+    std::fprintf(fd, "\n]}\n");
+
+    std::fclose(fd);
+}
+
+int main(int argc, char **argv)
+{
+    int seeds = c_default_seeds;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *json_path = nullptr;
+    const char *label = "";
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--seeds=", 8) == 0)
+            seeds = std::max(1, std::atoi(argv[i] + 8));
+        else if (std::strncmp(argv[i], "--threads=", 10) == 0)
+            threads = std::max(1, std::atoi(argv[i] + 10));
+        else if (std::strncmp(argv[i], "--json=", 7) == 0)
+            json_path = argv[i] + 7;
+        else if (std::strncmp(argv[i], "--label=", 8) == 0)
+            label = argv[i] + 8;
+        else {
+            std::fprintf(stderr, "usage: %s [--seeds=N] [--threads=N] "
+                    "[--json=PATH] [--label=TEXT]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Recording is not part of any measurement
+    std::vector<bench::recording> recordings;
+    for (int i = 0; i < seeds; ++i) {
+        mpe::option option;
+        option.seed = i + 1;
+        recordings.push_back(bench::record_bot_game(option));
+    }
+
+    std::printf("%-8s %7s %10s %12s %10s %10s %10s\n", "kind", "threads",
+            "games/s", "ticks/s", "allocs/t", "bytes/t", "scaling");
+
+    std::vector<result> results;
+    for (int kind = 0; kind < kind_length; ++kind) {
+        const game_kind k = static_cast<game_kind>(kind);
+
+        const result single = run(k, 1, seeds, recordings);
+        results.push_back(single);
+        print(single, single);
+
+        if (threads > 1) {
+            results.push_back(run(k, threads, seeds, recordings));
+            print(results.back(), single);
+        }
+    }
+
+    const long rss = peak_rss_kb();
+    std::printf("peak rss: %ld KiB\n", rss);
+
+    if (json_path)
+        write_json(json_path, label, results, rss);
+}
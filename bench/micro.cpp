@@ -0,0 +1,163 @@
+///
+// micro.cpp
+//
+// Micro-benchmarks of the engine primitives which are run every tick: block
+// movement and collision, field updates, the randomizer and a full engine
+// update. Run with --help for options.
+
+#include <cassert>
+#include <random>
+#include <vector>
+
+#include "bench/bench.hpp"
+#include "bench/games.hpp"
+#include "mpe/block.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/field.hpp"
+#include "mpe/randomizer/bag.hpp"
+#include "mpe/randomizer/memoryless.hpp"
+#include "mpe/wallkick/srs.hpp"
+
+// Seed used for every board and game, so that runs are comparable
+static constexpr unsigned c_seed = 1;
+
+// Rows of garbage on the representative board
+static constexpr int c_garbage_rows = 8;
+
+// Block ids used by the benchmarks (the randomizer produces 0-6)
+static constexpr mpe::block_type c_i = 0;
+static constexpr mpe::block_type c_t = 1;
+
+// Return a board partway through a game: c_garbage_rows rows, each with a
+// single hole, with the lowest full_rows rows completed.
+static mpe::field midgame(const int full_rows = 0)
+{
+    mpe::field field;
+    std::mt19937 generator(c_seed);
+    std::uniform_int_distribution<int> column(0, field.width - 1);
+
+    for (int y = 0; y < c_garbage_rows; ++y) {
+        const int hole = y < full_rows ? -1 : column(generator);
+        for (int x = 0; x < field.width; ++x) {
+            if (x != hole)
+                field.fill(x, y);
+        }
+    }
+
+    return field;
+}
+
+static void bench_block(bench::suite &suite)
+{
+    const mpe::field board = midgame();
+    const mpe::wallkick::SRS srs;
+
+    suite.run_fresh("block::collision", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.collision(board)); });
+
+    suite.run_fresh("block::move_left", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.move_left(board)); });
+
+    suite.run_fresh("block::move_right", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.move_right(board)); });
+
+    suite.run_fresh("block::move_down", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.move_down(board)); });
+
+    suite.run_fresh("block::rotate_right/srs", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.rotate_right(board, srs)); });
+
+    suite.run_fresh("block::rotate_left/srs", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.rotate_left(board, srs)); });
+
+    // A vertical I against the right wall has to be kicked to rotate
+    mpe::block wall(c_i, 1);
+    wall.x = board.width - 3;
+    {
+        mpe::block b = wall;
+        assert(b.rotate_right(board, srs) && b.kick > 0);
+    }
+
+    suite.run_fresh("block::rotate_right/srs-kick", wall,
+        [&](mpe::block &b) { bench::keep(b.rotate_right(board, srs)); });
+
+    suite.run_fresh("block::hard_drop", mpe::block(c_t),
+        [&](mpe::block &b) { bench::keep(b.hard_drop(board)); });
+}
+
+static void bench_field(bench::suite &suite)
+{
+    mpe::block landed(c_t);
+    landed.hard_drop(midgame());
+
+    suite.run_fresh("field::place_block", midgame(),
+        [&](mpe::field &f) { f.place_block(landed); });
+
+    suite.run_fresh("field::line_clear/none", midgame(),
+        [](mpe::field &f) { bench::keep(f.line_clear()); });
+
+    suite.run_fresh("field::line_clear/single", midgame(1),
+        [](mpe::field &f) { bench::keep(f.line_clear()); });
+
+    suite.run_fresh("field::line_clear/tetris", midgame(4),
+        [](mpe::field &f) { bench::keep(f.line_clear()); });
+}
+
+static void bench_randomizer(bench::suite &suite)
+{
+    mpe::randomizer::bag bag(c_seed);
+    mpe::randomizer::memoryless memoryless(c_seed);
+
+    suite.run("randomizer::bag::next",
+        [&] { bench::keep(bag.next()); });
+
+    suite.run("randomizer::bag::preview_pieces",
+        [&] { bench::keep(bag.preview_pieces()); });
+
+    suite.run("randomizer::memoryless::next",
+        [&] { bench::keep(memoryless.next()); });
+}
+
+static void bench_engine(bench::suite &suite)
+{
+    mpe::option option;
+    option.seed = c_seed;
+
+    // With no input the block falls under gravity and then rests
+    mpe::engine idle(option);
+    suite.run("engine::update/idle", [&] { idle.update(); });
+
+    // A full game, restarted outside of the timed region once it ends. Key
+    // events are queued before each tick as they would arrive in a live game,
+    // so only the updates are timed (along with one clock read each).
+    const bench::recording game = bench::record_bot_game(option);
+    bench::playback replay(option, game);
+
+    suite.run_timed("engine::update/bot-replay", [&](const int64_t n) {
+        int64_t total = 0;
+
+        for (int64_t done = 0; done < n; ++done) {
+            if (!replay.engine->running)
+                replay.restart();
+
+            const int64_t now = replay.feed();
+            const auto start = bench::clock_type::now();
+            replay.engine->update(now);
+            total += bench::elapsed_ns(start);
+        }
+
+        return total;
+    });
+}
+
+int main(int argc, char **argv)
+{
+    bench::suite suite(argc, argv);
+
+    bench_block(suite);
+    bench_field(suite);
+    bench_randomizer(suite);
+    bench_engine(suite);
+
+    return suite.finish();
+}
@@ -0,0 +1,477 @@
+///
+// ai/bot.hpp
+//
+// A reference computer player. The bot performs a beam search over the
+// current block, the hold block and the randomizer preview, scoring each
+// resulting field with a simple heuristic. The best first placement is then
+// converted into a finesse-optimal key timeline which is fed to the engine's
+// keystate one tick at a time.
+//
+// Placements for blocks at their spawn position are memoised by the surface of
+// the field they are placed on. This includes the root search, since the
+// current block is usually still at spawn when the bot thinks. Only the
+// placements are reused; the path to the chosen one is rebuilt by the finesse
+// table.
+//
+// Fields reached by different placement orders are detected through their
+// Zobrist hash. Duplicates are removed from each layer of the beam, and field
+// evaluations are cached in a transposition table shared by all threads.
+//
+// The search is deterministic for a given engine state regardless of the
+// number of worker threads used, which makes it suitable as a reproducible
+// workload.
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpe/ai/features.hpp"
+#include "mpe/ai/movegen.hpp"
+#include "mpe/ai/reachability.hpp"
+#include "mpe/ai/transposition.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/finesse.hpp"
+
+namespace mpe::ai {
+
+// Options which control the search performed by a bot.
+struct bot_option
+{
+    bot_option() :
+        beam_width(32), depth(4), threads(1), expectimax(false),
+        table_bits(16), reachability_bits(8), lines_weight(0.760666f), weights{}
+    {
+        weights[feature::aggregate_height] = -0.510066f;
+        weights[feature::holes] = -0.35663f;
+        weights[feature::bumpiness] = -0.184483f;
+    }
+
+    // Number of fields kept at each layer of the search
+    int beam_width;
+
+    // Maximum number of pieces searched, including the current block. This is
+    // limited further by the number of preview pieces available.
+    int depth;
+
+    // Number of worker threads used to expand each layer
+    int threads;
+
+    // Score the final layer by the expected value over all seven pieces,
+    // uniformly, instead of its static evaluation. The randomizer is not
+    // consulted, so a bag which cannot produce some pieces next is still
+    // averaged over all of them.
+    bool expectimax;
+
+    // The transposition table has 2^table_bits buckets
+    int table_bits;
+
+    // The reachability cache has 2^reachability_bits sets
+    int reachability_bits;
+
+    // Reward for each line cleared
+    float lines_weight;
+
+    // Weight of each board feature when evaluating a field
+    std::array<float, feature_length> weights;
+};
+
+class bot
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    bot(const bot_option &option = bot_option()) :
+        option(option), table(option.table_bits),
+        reachability(option.reachability_bits), step(0), next(0), end(-1)
+    {}
+
+    // Apply the next tick of the current plan to the engine keystate. This
+    // should be called once before each engine update. A new plan is
+    // computed whenever the previous one has completed.
+    void update(mpe::engine &engine)
+    {
+        if (step > end) {
+            think(engine);
+        }
+
+        for (; next < plan.size() && plan[next].tick == step; ++next) {
+            if (plan[next].down)
+                engine.keystate.key_down(plan[next].key);
+            else
+                engine.keystate.key_up(plan[next].key);
+        }
+
+        step++;
+    }
+
+    // Search the current engine state and replace the current plan with the
+    // inputs for the best placement found.
+    void think(mpe::engine &engine)
+    {
+        const int threads = std::max(option.threads, 1);
+        std::vector<worker> workers(threads, worker(engine));
+
+        pieces.clear();
+        pieces.push_back(engine.block.id);
+        for (int id : engine.randomizer->preview_pieces()) {
+            if ((int) pieces.size() > option.depth)
+                break;
+            pieces.push_back(id);
+        }
+
+        current = &engine.block;
+        roots.clear();
+        table.age();
+
+        std::vector<node> beam;
+        beam.push_back({engine.field, engine.hold ? engine.hold->id : -1,
+                        0, 0, 0, -1});
+
+        for (int depth = 0; depth < option.depth; ++depth) {
+            std::vector<std::vector<candidate>> children(beam.size());
+
+            parallel(beam.size(), [&](const int i, const int w) {
+                expand(beam[i], i, depth == 0 && engine.block.can_be_held,
+                       workers[w], children[i]);
+            });
+
+            std::vector<candidate> layer;
+            for (size_t i = 0; i < children.size(); ++i) {
+                if (depth == 0) {
+                    for (auto &c : children[i]) {
+                        c.root = roots.size();
+                        roots.push_back({c.held, c.place});
+                    }
+                }
+                layer.insert(layer.end(), children[i].begin(),
+                             children[i].end());
+            }
+
+            if (layer.empty())
+                break;
+
+            std::stable_sort(layer.begin(), layer.end(),
+                [](const candidate &a, const candidate &b) {
+                    return a.score > b.score;
+                });
+
+            std::vector<node> next;
+            std::vector<uint64_t> seen;
+            for (const auto &c : layer) {
+                if ((int) next.size() == option.beam_width)
+                    break;
+                if (std::find(seen.begin(), seen.end(), c.key) != seen.end())
+                    continue;
+
+                seen.push_back(c.key);
+                next.push_back(materialize(beam[c.parent], c));
+            }
+            beam = std::move(next);
+        }
+
+        plan.clear();
+        step = 0;
+        next = 0;
+        end = 0;
+
+        if (beam.empty() || beam[0].root < 0)
+            return;
+
+        if (option.expectimax)
+            rescore(beam, workers);
+
+        const auto &best = roots[beam[0].root];
+        const mpe::block start = best.held
+            ? mpe::block(engine.hold ? engine.hold->id : pieces[1])
+            : engine.block;
+
+        auto &finesse = *engine.finesse;
+
+        std::vector<finesse_input> inputs;
+        if (!finesse.path(engine.field, start, to_block(best.place), inputs))
+            return;
+
+        // Holding takes effect in the first tick, so the placement inputs
+        // begin once it has been released.
+        const int offset = best.held ? 1 : 0;
+        if (best.held) {
+            plan.push_back({0, keycode::c, true});
+            plan.push_back({1, keycode::c, false});
+        }
+
+        for (auto key : finesse.timeline(engine.field, start, inputs,
+                                          engine.option)) {
+            key.tick += offset;
+            plan.push_back(key);
+        }
+
+        std::stable_sort(plan.begin(), plan.end(),
+            [](const scheduled_key &a, const scheduled_key &b) {
+                return a.tick < b.tick;
+            });
+        end = plan.back().tick;
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Options used for the search
+    bot_option option;
+
+    // Cached field evaluations, shared by all search threads
+    transposition_table table;
+
+    // Cached placements, shared by all search threads
+    reachability_cache reachability;
+
+  private:
+    // A field reached during the search.
+    struct node
+    {
+        mpe::field field;
+
+        // Held block id (-1 if nothing is held)
+        int hold;
+
+        // Index into the piece sequence of the next piece to be placed
+        int queue;
+
+        // Reward accumulated by placements leading to this node
+        float reward;
+
+        // Total score of this node
+        float score;
+
+        // Index of the first placement which led to this node
+        int root;
+    };
+
+    // A child of a node which has been scored but not yet constructed.
+    struct candidate
+    {
+        int parent;
+        placement place;
+        bool held;
+        int hold;
+        int queue;
+        float reward;
+        float score;
+        int root;
+        uint64_t key;
+    };
+
+    // Scratch state owned by each search thread.
+    struct worker
+    {
+        worker(const mpe::engine &engine) :
+            gen(*engine.wallkick), scratch(engine.field)
+        {}
+
+        movegen gen;
+        mpe::field scratch;
+        std::vector<placement> placements;
+    };
+
+    // The first decision of a search.
+    struct root_decision
+    {
+        bool held;
+        placement place;
+    };
+
+    // Table depths used for static and expected evaluations. Static entries
+    // are keyed by the field hash and expected entries by the node key.
+    static constexpr int c_static_depth = 0;
+    static constexpr int c_expected_depth = 1;
+
+    // Call fn(i, worker) for all i in [0, n), spreading the work over the
+    // configured number of threads.
+    template <typename F>
+    void parallel(const int n, F fn)
+    {
+        const int threads = std::min(std::max(option.threads, 1), n);
+
+        auto work = [&](const int w) {
+            for (int i = w; i < n; i += threads)
+                fn(i, w);
+        };
+
+        std::vector<std::thread> workers;
+        for (int w = 1; w < threads; ++w)
+            workers.emplace_back(work, w);
+
+        work(0);
+        for (auto &t : workers)
+            t.join();
+    }
+
+    // Score all placements available from the given node.
+    void expand(const node &n, const int index, const bool can_hold,
+                worker &w, std::vector<candidate> &out)
+    {
+        if (n.queue >= (int) pieces.size())
+            return;
+
+        const int piece = pieces[n.queue];
+        const bool root = n.root < 0;
+
+        // Place the current piece. At the root this is the engine block, which
+        // is only looked up in the reachability cache if it is still at spawn.
+        {
+            const mpe::block start = root ? *current : mpe::block(piece);
+            score(n, index, w, start, false, n.hold, n.queue + 1, out);
+        }
+
+        // Place the held piece (or the next piece if nothing is held)
+        if (!root || can_hold) {
+            const int next = n.queue + 1;
+            if (n.hold == -1 && next < (int) pieces.size() &&
+                    pieces[next] != piece) {
+                score(n, index, w, mpe::block(pieces[next]), true, piece,
+                      next + 1, out);
+            }
+            else if (n.hold != -1 && n.hold != piece) {
+                score(n, index, w, mpe::block(n.hold), true, piece, next,
+                      out);
+            }
+        }
+    }
+
+    // Score every placement of the start block on the node's field.
+    void score(const node &n, const int index, worker &w,
+               const mpe::block &start, const bool held, const int hold,
+               const int queue, std::vector<candidate> &out)
+    {
+        mpe::field &scratch = w.scratch;
+
+        for (const auto &p : generate(w, n.field, start)) {
+            scratch = n.field;
+            scratch.place_block(to_block(p));
+            const float reward = n.reward +
+                option.lines_weight * scratch.line_clear();
+            const uint64_t key = node_key(scratch, hold, queue);
+
+            out.push_back({index, p, held, hold, queue, reward,
+                           reward + evaluate(scratch), n.root, key});
+        }
+    }
+
+    // Construct the node described by a candidate.
+    node materialize(const node &parent, const candidate &c)
+    {
+        node n = {parent.field, c.hold, c.queue, c.reward, c.score, c.root};
+        n.field.place_block(to_block(c.place));
+        n.field.line_clear();
+        return n;
+    }
+
+    // Replace the score of each node with the expected score of its best
+    // placement, averaged uniformly over all seven pieces.
+    void rescore(std::vector<node> &beam, std::vector<worker> &workers)
+    {
+        parallel(beam.size(), [&](const int i, const int w) {
+            mpe::field &scratch = workers[w].scratch;
+            const node &n = beam[i];
+            const uint64_t key = node_key(n.field, n.hold, n.queue);
+
+            transposition_entry entry;
+            if (table.probe(key, c_expected_depth, entry)) {
+                beam[i].score = n.reward + entry.score;
+                return;
+            }
+
+            float total = 0;
+
+            for (int id = 0; id < 7; ++id) {
+                float best = n.score - n.reward;
+                bool found = false;
+
+                for (const auto &p : generate(workers[w], n.field,
+                                              mpe::block(id))) {
+                    scratch = n.field;
+                    scratch.place_block(to_block(p));
+                    const float s =
+                        option.lines_weight * scratch.line_clear() +
+                        evaluate(scratch);
+
+                    if (!found || s > best)
+                        best = s;
+                    found = true;
+                }
+
+                total += best;
+            }
+
+            table.store(key, c_expected_depth, total / 7);
+            beam[i].score = n.reward + total / 7;
+        });
+
+        std::stable_sort(beam.begin(), beam.end(),
+            [](const node &a, const node &b) {
+                return a.score > b.score;
+            });
+    }
+
+    // Return all placements of the start block on the field.
+    const std::vector<placement>& generate(worker &w, const mpe::field &field,
+                                           const mpe::block &start)
+    {
+        return reachability.generate(w.gen, field, start, w.placements);
+    }
+
+    // Return a block at the specified placement.
+    static mpe::block to_block(const placement &p)
+    {
+        mpe::block b(p.id, p.r);
+        b.x = p.x;
+        b.y = p.y;
+        return b;
+    }
+
+    // Return the heuristic value of a field. Higher is better. The value only
+    // depends on the field, so it is cached under the field hash alone.
+    float evaluate(const mpe::field &field)
+    {
+        transposition_entry entry;
+        if (table.probe(field.hash, c_static_depth, entry))
+            return entry.score;
+
+        const feature_vector f = extract_features(field);
+
+        float value = 0;
+        for (int i = 0; i < feature_length; ++i)
+            value += option.weights[i] * f[i];
+
+        table.store(field.hash, c_static_depth, value);
+        return value;
+    }
+
+    // Block ids of the current block followed by the preview pieces
+    std::vector<int> pieces;
+
+    // The engine block at the start of the current search
+    const mpe::block *current;
+
+    // Decisions available at the first layer of the search
+    std::vector<root_decision> roots;
+
+    // Key transitions of the current plan, ordered by tick
+    std::vector<scheduled_key> plan;
+
+    // Current tick of the plan
+    int step;
+
+    // Index of the next key transition in the plan
+    size_t next;
+
+    // Last tick of the plan
+    int end;
+};
+
+} // namespace mpe::ai
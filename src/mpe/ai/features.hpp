@@ -0,0 +1,97 @@
+///
+// ai/features.hpp
+//
+// Board features commonly used by heuristic players. All features are computed
+// directly from the row bitmasks of a field using shifts and popcounts, without
+// branching on individual cells, so that large numbers of candidate fields can
+// be evaluated cheaply.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "mpe/field.hpp"
+#include "mpe/utility.hpp"
+
+namespace mpe::ai {
+
+enum feature {
+    // Empty cells with a filled cell somewhere above them
+    holes,
+
+    // Filled cells with a hole somewhere below them
+    covered_cells,
+
+    // Sum of the depths of all wells. A well cell is an open cell whose left
+    // and right neighbours are filled (or are walls).
+    well_depth,
+
+    // Filled/empty changes along each row (walls count as filled). Rows above
+    // the highest filled cell are not counted.
+    row_transitions,
+
+    // Filled/empty changes along each column (the floor counts as filled)
+    column_transitions,
+
+    // Height of the tallest column
+    max_height,
+
+    // Sum of all column heights
+    aggregate_height,
+
+    // Sum of height differences between adjacent columns
+    bumpiness,
+
+    feature_length,
+};
+
+typedef std::array<int, feature_length> feature_vector;
+
+// Compute all features of the specified field.
+inline feature_vector extract_features(const field &field)
+{
+    const int w = field.width;
+    const uint32_t full = field.full_row();
+    const uint32_t left_wall = 1;
+    const uint32_t right_wall = 1u << (w - 1);
+
+    feature_vector f = {};
+
+    // Columns which have a filled cell at or above the current row
+    uint32_t above = 0;
+
+    for (int y = field.height + field.hidden - 1; y >= 0; --y) {
+        const uint32_t row = field.rows[y];
+        const uint32_t below = y ? field.rows[y - 1] : full;
+
+        f[feature::holes] += popcount(above & ~row);
+        above |= row;
+
+        const int in_stack = above != 0;
+        f[feature::max_height] += in_stack;
+        f[feature::aggregate_height] += popcount(above);
+        f[feature::bumpiness] += popcount((above ^ (above >> 1)) & (full >> 1));
+
+        const uint32_t left = (row << 1) | left_wall;
+        const uint32_t right = (row >> 1) | right_wall;
+        f[feature::well_depth] += popcount(~above & left & right & full);
+
+        const uint32_t walled = (row << 1) | 1 | (1u << (w + 1));
+        f[feature::row_transitions] +=
+            popcount((walled ^ (walled >> 1)) & ((full << 1) | 1)) * in_stack;
+        f[feature::column_transitions] += popcount(row ^ below);
+    }
+
+    // A second pass from the floor up finds filled cells above open cells.
+    uint32_t open_below = 0;
+    for (int y = 0; y < field.height + field.hidden; ++y) {
+        const uint32_t row = field.rows[y];
+        f[feature::covered_cells] += popcount(row & open_below);
+        open_below |= ~row & full;
+    }
+
+    return f;
+}
+
+} // namespace mpe::ai
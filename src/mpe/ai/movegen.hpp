@@ -0,0 +1,253 @@
+///
+// ai/movegen.hpp
+//
+// Generates every placement a block can reach on a field from its current
+// position. This is a breadth-first search over (x, y, rotation) states using
+// the same block functions as the engine, so any placement found can be
+// reproduced with real inputs.
+//
+// The search records how each state was reached, which allows the moves
+// required for any placement to be recovered afterwards.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <vector>
+
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/wallkick/interface.hpp"
+
+namespace mpe::ai {
+
+// The individual moves that can be applied to a block during a search.
+enum action {
+    shift_left, shift_right, soft_drop, rotate_left, rotate_right,
+    action_length,
+};
+
+// A final resting position of a block on a field.
+struct placement {
+    block_type id;
+    int x;
+    int y;
+    rotation_type r;
+};
+
+// Blocks can be positioned to the left of the field since the leftmost cell
+// of a block is not always at its origin.
+static constexpr int c_x_margin = 2;
+
+// The furthest distance a wallkick can move a block upwards. Rotations are
+// not tried when they could push a block past the top of the field.
+static constexpr int c_max_kick = 2;
+
+// The furthest a search looks below a block position. Block cells extend three
+// rows below the position and a wallkick can move a block down two rows.
+static constexpr int c_probe_depth = 5;
+
+class movegen
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    movegen(const wallkick::interface &wallkick) : wallkick(wallkick) {}
+
+    // Generate all unique placements reachable by the start block. Placements
+    // which occupy the same cells are only reported once, using the lowest
+    // rotation that reaches them. Placements are ordered by position so the
+    // result does not depend on the order of the search. The returned
+    // reference is valid until the next call.
+    const std::vector<placement>& generate(const field &field,
+                                           const block &start)
+    {
+        width = field.width + c_x_margin;
+        rows = field.height + field.hidden;
+
+        const size_t states = 4 * rows * width;
+        if (parent.size() != states) {
+            parent.resize(states);
+            via.resize(states);
+        }
+        std::fill(parent.begin(), parent.end(), -1);
+
+        queue.clear();
+        footprints.clear();
+        placements.clear();
+
+        for (int r = 0; r < 4; ++r)
+            shapes[r] = mpe::block(start.id, r);
+
+        mpe::block b = start;
+        if (b.y >= rows || b.collision(field))
+            return placements;
+
+        origin = index(b.x, b.y, b.r);
+        parent[origin] = origin;
+        queue.push_back(origin);
+        low = b.y;
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+            const int s = queue[head];
+            const int sr = s / (rows * width);
+            const int sy = (s / width) % rows;
+            const int sx = s % width - c_x_margin;
+
+            reset(b, sx, sy, sr);
+            if (b.move_left(field))
+                visit(s, b, shift_left);
+
+            reset(b, sx, sy, sr);
+            if (b.move_right(field))
+                visit(s, b, shift_right);
+
+            reset(b, sx, sy, sr);
+            if (b.move_down(field))
+                visit(s, b, soft_drop);
+            else
+                record(b);
+
+            if (sy + c_max_kick < rows) {
+                reset(b, sx, sy, sr);
+                if (b.rotate_left(field, wallkick))
+                    visit(s, b, rotate_left);
+
+                reset(b, sx, sy, sr);
+                if (b.rotate_right(field, wallkick))
+                    visit(s, b, rotate_right);
+            }
+        }
+
+        std::sort(placements.begin(), placements.end(),
+            [](const placement &a, const placement &b) {
+                return std::tie(a.y, a.x, a.r) < std::tie(b.y, b.x, b.r);
+            });
+
+        return placements;
+    }
+
+    // Return the lowest y position reached by the previous call to generate.
+    // The search never examines a cell more than c_probe_depth rows below it.
+    int lowest() const
+    {
+        return low;
+    }
+
+    // Return the moves required to reach the specified placement from the
+    // start block of the previous call to generate. The placement must have
+    // been returned by that call.
+    std::vector<action> path(const placement &target) const
+    {
+        std::vector<action> moves;
+
+        for (int s = index(target.x, target.y, target.r); s != origin;
+                s = parent[s]) {
+            moves.push_back(static_cast<action>(via[s]));
+        }
+
+        std::reverse(moves.begin(), moves.end());
+        return moves;
+    }
+
+  private:
+    // Return the state index of the specified block position.
+    int index(const int x, const int y, const rotation_type r) const
+    {
+        return (r * rows + y) * width + x + c_x_margin;
+    }
+
+    // Move the working block to the specified state. Assigning from an
+    // existing shape reuses the block storage.
+    void reset(mpe::block &b, const int x, const int y, const rotation_type r)
+    {
+        if (b.r != r)
+            b = shapes[r];
+        b.x = x;
+        b.y = y;
+    }
+
+    // Mark the state of the given block as reached by the specified move.
+    void visit(const int from, const mpe::block &b, const action move)
+    {
+        if (b.y >= rows)
+            return;
+
+        const int s = index(b.x, b.y, b.r);
+        if (parent[s] == -1) {
+            parent[s] = from;
+            via[s] = move;
+            queue.push_back(s);
+            low = std::min(low, b.y);
+        }
+    }
+
+    // Record the given block as a placement unless a previous placement
+    // covered the same cells.
+    void record(const mpe::block &b)
+    {
+        int minx = b.x + b.data[0].x, miny = b.y + b.data[0].y;
+        for (const auto &p : b.data) {
+            minx = std::min(minx, b.x + p.x);
+            miny = std::min(miny, b.y + p.y);
+        }
+
+        unsigned mask = 0;
+        for (const auto &p : b.data)
+            mask |= 1u << ((b.y + p.y - miny) * 4 + (b.x + p.x - minx));
+
+        const unsigned key = (mask << 16) | (miny << 8) | minx;
+        const auto it = std::find(footprints.begin(), footprints.end(), key);
+        if (it != footprints.end()) {
+            placement &p = placements[it - footprints.begin()];
+            if (b.r < p.r)
+                p = {b.id, b.x, b.y, b.r};
+            return;
+        }
+
+        footprints.push_back(key);
+        placements.push_back({b.id, b.x, b.y, b.r});
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Wallkicks applied when rotating
+    const wallkick::interface &wallkick;
+
+    // Block templates for each rotation of the block being searched
+    std::array<mpe::block, 4> shapes;
+
+    // Number of x positions in the state space
+    int width;
+
+    // Number of y positions in the state space
+    int rows;
+
+    // State index of the start block
+    int origin;
+
+    // Lowest y position reached by the search
+    int low;
+
+    // The state each state was first reached from (-1 if unvisited)
+    std::vector<int> parent;
+
+    // The move used to reach each state
+    std::vector<char> via;
+
+    // Breadth-first search queue
+    std::vector<int> queue;
+
+    // Cell footprints of all recorded placements
+    std::vector<unsigned> footprints;
+
+    // Unique placements found by the last search
+    std::vector<placement> placements;
+};
+
+} // namespace mpe::ai
@@ -0,0 +1,296 @@
+///
+// ai/reachability.hpp
+//
+// Memoises move generation results by the surface of a field. The placements
+// reachable by a block only depend on the part of the field it can get near,
+// so fields which share the same surface but differ further down (or sit at a
+// different height) share the same result.
+//
+// The surface signature is built as follows:
+//  - The open cells connected to the top of the field are flood filled. The
+//    lowest such row is the deepest a block can normally reach.
+//  - The signature covers every row from c_probe_depth rows below that up to
+//    the highest filled cell. Rows are stored relative to this base so the
+//    same surface matches at any height.
+//  - The distance from the surface to the spawn position is included, clamped
+//    to a height above which the free space is always fully reachable.
+//
+// A wallkick may occasionally move a block into a sealed cavity below the
+// flood filled region. The search reports how low it went, and results which
+// depended on rows outside the signature are never cached.
+//
+// Entries are kept in a set-associative table with CLOCK eviction in each
+// set, so memory use is fixed at construction.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mpe/ai/movegen.hpp"
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/utility.hpp"
+
+namespace mpe::ai {
+
+// Maximum number of placements stored for a single surface. Results with more
+// placements are not cached.
+static constexpr int c_max_cached_placements = 128;
+
+// Number of entries in each set of the cache
+static constexpr int c_reachability_ways = 8;
+
+// Spawn clearance above which additional free rows do not change the result
+static constexpr int c_max_clearance = 10;
+
+// Maximum number of field rows supported by the cache
+static constexpr int c_max_signature_rows = 64;
+
+class reachability_cache
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    // Create a cache with 2^bits sets.
+    reachability_cache(const int bits = 8) :
+        mask((size_t(1) << bits) - 1),
+        sets(new set[size_t(1) << bits]),
+        hits(0), misses(0), evictions(0), uncacheable(0)
+    {}
+
+    // Return the placements reachable by the start block, using a cached
+    // result where possible. Only blocks at their spawn position are cached.
+    // The returned reference is valid until the next call with the same out
+    // vector or movegen.
+    const std::vector<placement>& generate(movegen &gen, const field &field,
+                                           const block &start,
+                                           std::vector<placement> &out)
+    {
+        signature sig;
+        if (!make_signature(field, start, sig)) {
+            uncacheable.fetch_add(1, std::memory_order_relaxed);
+            return gen.generate(field, start);
+        }
+
+        set &s = sets[sig.key & mask];
+
+        {
+            std::lock_guard<std::mutex> lock(s.lock);
+            for (auto &e : s.entries) {
+                if (e.count < 0 || e.key != sig.key || e.check != sig.check)
+                    continue;
+
+                e.referenced = true;
+                out.clear();
+                for (int i = 0; i < e.count; ++i) {
+                    const compact &c = e.placements[i];
+                    out.push_back({start.id, c.x, c.y + sig.base, c.r});
+                }
+
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return out;
+            }
+        }
+
+        misses.fetch_add(1, std::memory_order_relaxed);
+        const auto &result = gen.generate(field, start);
+
+        if (sig.base > 0 && gen.lowest() - c_probe_depth < sig.base) {
+            uncacheable.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+        if ((int) result.size() > c_max_cached_placements) {
+            uncacheable.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+
+        std::lock_guard<std::mutex> lock(s.lock);
+        for (const auto &e : s.entries) {
+            // Another thread stored the same surface during the search
+            if (e.count >= 0 && e.key == sig.key && e.check == sig.check)
+                return result;
+        }
+
+        entry &e = s.victim();
+        if (e.count >= 0)
+            evictions.fetch_add(1, std::memory_order_relaxed);
+
+        e.key = sig.key;
+        e.check = sig.check;
+        e.referenced = false;
+        e.count = result.size();
+        for (int i = 0; i < e.count; ++i) {
+            const placement &p = result[i];
+            e.placements[i] = {int8_t(p.x), int8_t(p.y - sig.base),
+                               int8_t(p.r)};
+        }
+
+        return result;
+    }
+
+    // Return the number of lookups answered from the cache
+    uint64_t hit_count() const
+    {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    // Return the number of lookups which required a search
+    uint64_t miss_count() const
+    {
+        return misses.load(std::memory_order_relaxed);
+    }
+
+    // Return the number of entries replaced by newer results
+    uint64_t eviction_count() const
+    {
+        return evictions.load(std::memory_order_relaxed);
+    }
+
+    // Return the number of lookups which could not use the cache
+    uint64_t uncacheable_count() const
+    {
+        return uncacheable.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // A placement stored relative to the signature base
+    struct compact
+    {
+        int8_t x;
+        int8_t y;
+        int8_t r;
+    };
+
+    struct entry
+    {
+        entry() : key(0), check(0), referenced(false), count(-1) {}
+
+        uint64_t key;
+        uint64_t check;
+        bool referenced;
+
+        // Number of placements stored (-1 if the entry is unused)
+        int count;
+
+        std::array<compact, c_max_cached_placements> placements;
+    };
+
+    struct set
+    {
+        set() : hand(0) {}
+
+        // Return the entry to replace, advancing the clock hand past any
+        // recently referenced entries.
+        entry& victim()
+        {
+            for (;;) {
+                entry &e = entries[hand];
+                hand = (hand + 1) % c_reachability_ways;
+
+                if (e.count < 0 || !e.referenced)
+                    return e;
+                e.referenced = false;
+            }
+        }
+
+        std::mutex lock;
+        int hand;
+        std::array<entry, c_reachability_ways> entries;
+    };
+
+    struct signature
+    {
+        uint64_t key;
+        uint64_t check;
+        int base;
+    };
+
+    // Compute the surface signature for the start block on the field,
+    // returning false if the result cannot be cached.
+    static bool make_signature(const field &field, const block &start,
+                               signature &sig)
+    {
+        const int n = field.height + field.hidden;
+        const mpe::block spawn(start.id);
+
+        if (n > c_max_signature_rows || start.x != spawn.x ||
+                start.y != spawn.y || start.r != spawn.r) {
+            return false;
+        }
+
+        const uint32_t full = field.full_row();
+        std::array<uint32_t, c_max_signature_rows> air = {};
+
+        // Flood fill the open cells connected to the top row. Repeat until
+        // nothing changes so that cells reached by moving back upwards are
+        // included.
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int y = n - 1; y >= 0; --y) {
+                const uint32_t open = ~field.rows[y] & full;
+                uint32_t seed = air[y];
+                seed |= y == n - 1 ? open : air[y + 1];
+                seed |= y > 0 ? air[y - 1] : 0;
+                seed &= open;
+
+                for (uint32_t grown; (grown = (seed | (seed << 1) |
+                        (seed >> 1)) & open) != seed;) {
+                    seed = grown;
+                }
+
+                if (seed != air[y]) {
+                    air[y] = seed;
+                    changed = true;
+                }
+            }
+        }
+
+        int low = 0;
+        while (low < n && !air[low])
+            low++;
+
+        int top = n - 1;
+        while (top >= 0 && !field.rows[top])
+            top--;
+
+        sig.base = std::max(low - c_probe_depth, 0);
+        const int clearance = std::min(spawn.y - top, c_max_clearance);
+        const uint64_t header = start.id | (sig.base == 0) << 4 |
+                                uint64_t(clearance + 32) << 8 |
+                                uint64_t(top - sig.base + 1) << 16;
+
+        sig.key = mix64(header);
+        sig.check = mix64(~header);
+        for (int y = sig.base; y <= top; ++y) {
+            sig.key = mix64(sig.key ^ field.rows[y]);
+            sig.check = mix64(sig.check + field.rows[y]);
+        }
+
+        return true;
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Set index mask
+    const size_t mask;
+
+    // Set storage
+    std::unique_ptr<set[]> sets;
+
+    // Instrumentation counters
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+    std::atomic<uint64_t> uncacheable;
+};
+
+} // namespace mpe::ai
@@ -0,0 +1,186 @@
+///
+// ai/transposition.hpp
+//
+// A fixed-size transposition table shared between search threads. Entries
+// are stored without locks using the xor scheme described by Hyatt and Mann:
+// each slot holds its data and the key xor'd with that data, so a torn write
+// from two racing threads simply fails verification and reads as a miss.
+//
+// Each bucket has two slots. The first keeps the deepest entry seen in the
+// current search, the second is always replaced.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "mpe/field.hpp"
+#include "mpe/utility.hpp"
+
+namespace mpe::ai {
+
+// A value stored in the transposition table
+struct transposition_entry
+{
+    float score;
+    int depth;
+};
+
+// Return the key of a search node, combining the field hash with the held
+// block and the position in the piece queue.
+inline uint64_t node_key(const field &field, const int hold, const int queue)
+{
+    return field.hash ^ mix64(0x100 + hold) ^ mix64(0x200 + queue);
+}
+
+class transposition_table
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    // Create a table with 2^bits buckets.
+    transposition_table(const int bits = 16) :
+        mask((size_t(1) << bits) - 1),
+        buckets(new bucket[size_t(1) << bits]),
+        generation(0), probes(0), hits(0)
+    {
+        clear();
+    }
+
+    // Remove all entries and reset the counters.
+    void clear()
+    {
+        for (size_t i = 0; i <= mask; ++i) {
+            for (auto &s : buckets[i].slots) {
+                s.check.store(0, std::memory_order_relaxed);
+                s.data.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        probes.store(0, std::memory_order_relaxed);
+        hits.store(0, std::memory_order_relaxed);
+    }
+
+    // Start a new search. Entries from older searches are replaced first.
+    void age()
+    {
+        generation = (generation + 1) & 0xff;
+    }
+
+    // Look up the entry stored for the given key and depth, returning true
+    // and filling out on a hit.
+    bool probe(const uint64_t key, const int depth, transposition_entry &out)
+    {
+        probes.fetch_add(1, std::memory_order_relaxed);
+
+        for (const auto &s : buckets[key & mask].slots) {
+            const uint64_t data = s.data.load(std::memory_order_relaxed);
+            const uint64_t check = s.check.load(std::memory_order_relaxed);
+
+            if ((check ^ data) == key && unpack_depth(data) == depth) {
+                out = {unpack_score(data), depth};
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Store an entry for the given key.
+    void store(const uint64_t key, const int depth, const float score)
+    {
+        auto &slots = buckets[key & mask].slots;
+        const uint64_t data = pack(score, depth);
+
+        // Prefer the first slot unless it holds a deeper entry from this search
+        const uint64_t current = slots[0].data.load(std::memory_order_relaxed);
+        auto &s = (unpack_generation(current) != generation ||
+                   unpack_depth(current) <= depth) ? slots[0] : slots[1];
+
+        s.data.store(data, std::memory_order_relaxed);
+        s.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    // Return the number of probes made since the last clear
+    uint64_t probe_count() const
+    {
+        return probes.load(std::memory_order_relaxed);
+    }
+
+    // Return the number of successful probes since the last clear
+    uint64_t hit_count() const
+    {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    // Return the fraction of probes which were hits
+    double hit_rate() const
+    {
+        const uint64_t p = probe_count();
+        return p ? double(hit_count()) / p : 0;
+    }
+
+  private:
+    // Data is packed as | generation:8 | depth:8 | unused:16 | score:32 |
+    uint64_t pack(const float score, const int depth) const
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &score, sizeof(bits));
+        return (uint64_t(generation) << 56) | (uint64_t(depth & 0xff) << 48) |
+               bits;
+    }
+
+    static float unpack_score(const uint64_t data)
+    {
+        const uint32_t bits = data & 0xffffffff;
+        float score;
+        std::memcpy(&score, &bits, sizeof(score));
+        return score;
+    }
+
+    static int unpack_depth(const uint64_t data)
+    {
+        return (data >> 48) & 0xff;
+    }
+
+    static int unpack_generation(const uint64_t data)
+    {
+        return data >> 56;
+    }
+
+    struct slot
+    {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+    };
+
+    struct bucket
+    {
+        slot slots[2];
+    };
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Bucket index mask
+    const size_t mask;
+
+    // Bucket storage
+    std::unique_ptr<bucket[]> buckets;
+
+    // Generation of the current search
+    int generation;
+
+    // Counters are kept on their own cache lines so that updates from
+    // several threads do not invalidate the members read on every probe.
+    alignas(64) std::atomic<uint64_t> probes;
+    alignas(64) std::atomic<uint64_t> hits;
+};
+
+} // namespace mpe::ai
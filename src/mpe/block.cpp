@@ -1,4 +1,6 @@
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 
 #include "mpe/field.hpp"
 #include "mpe/block.hpp"
@@ -12,62 +14,63 @@ static const int c_initial_x = 3;
 // The initial Y position a block is spawned at
 static const int c_initial_y = 24;
 
-// Blocks are not necessarily composed of 4-pieces, so a dynarray is
-// a suitable container for storage, and is better than a vector.
-static const std::vector<point> c_block_data[7][4] = {
+// The cells of each block in each rotation. Every block is made of
+// c_block_cells cells, so these are stored inline and copying a block never
+// allocates.
+static const std::array<point, c_block_cells> c_block_data[7][4] = {
     /* I Block */
     {
-        {{0, -1}, {1, -1}, {2, -1}, {3, -1}},
-        {{2,  0}, {2, -1}, {2, -2}, {2, -3}},
-        {{0, -2}, {1, -2}, {2, -2}, {3, -2}},
-        {{1,  0}, {1, -1}, {1, -2}, {1, -3}}
+        {{{0, -1}, {1, -1}, {2, -1}, {3, -1}}},
+        {{{2,  0}, {2, -1}, {2, -2}, {2, -3}}},
+        {{{0, -2}, {1, -2}, {2, -2}, {3, -2}}},
+        {{{1,  0}, {1, -1}, {1, -2}, {1, -3}}}
     },
     /* T Block */
     {
-        {{0, -1}, {1,  0}, {1, -1}, {2, -1}},
-        {{1,  0}, {1, -1}, {1, -2}, {2, -1}},
-        {{0, -1}, {1, -1}, {1, -2}, {2, -1}},
-        {{0, -1}, {1,  0}, {1, -1}, {1, -2}}
+        {{{0, -1}, {1,  0}, {1, -1}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {1, -2}, {2, -1}}},
+        {{{0, -1}, {1, -1}, {1, -2}, {2, -1}}},
+        {{{0, -1}, {1,  0}, {1, -1}, {1, -2}}}
     },
     /* L Block */
     {
-        {{0, -1}, {1, -1}, {2,  0}, {2, -1}},
-        {{1,  0}, {1, -1}, {1, -2}, {2, -2}},
-        {{0, -1}, {0, -2}, {1, -1}, {2, -1}},
-        {{0,  0}, {1,  0}, {1, -1}, {1, -2}}
+        {{{0, -1}, {1, -1}, {2,  0}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {1, -2}, {2, -2}}},
+        {{{0, -1}, {0, -2}, {1, -1}, {2, -1}}},
+        {{{0,  0}, {1,  0}, {1, -1}, {1, -2}}}
     },
     /* J Block */
     {
-        {{0,  0}, {0, -1}, {1, -1}, {2, -1}},
-        {{1,  0}, {1, -1}, {1, -2}, {2,  0}},
-        {{0, -1}, {1, -1}, {2, -1}, {2, -2}},
-        {{0, -2}, {1,  0}, {1, -1}, {1, -2}}
+        {{{0,  0}, {0, -1}, {1, -1}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {1, -2}, {2,  0}}},
+        {{{0, -1}, {1, -1}, {2, -1}, {2, -2}}},
+        {{{0, -2}, {1,  0}, {1, -1}, {1, -2}}}
     },
     /* S Block */
     {
-        {{0, -1}, {1,  0}, {1, -1}, {2,  0}},
-        {{1,  0}, {1, -1}, {2, -1}, {2, -2}},
-        {{0, -2}, {1, -1}, {1, -2}, {2, -1}},
-        {{0,  0}, {0, -1}, {1, -1}, {1, -2}}
+        {{{0, -1}, {1,  0}, {1, -1}, {2,  0}}},
+        {{{1,  0}, {1, -1}, {2, -1}, {2, -2}}},
+        {{{0, -2}, {1, -1}, {1, -2}, {2, -1}}},
+        {{{0,  0}, {0, -1}, {1, -1}, {1, -2}}}
     },
     /* Z Block */
     {
-        {{0,  0}, {1,  0}, {1, -1}, {2, -1}},
-        {{1, -1}, {1, -2}, {2,  0}, {2, -1}},
-        {{0, -1}, {1, -1}, {1, -2}, {2, -2}},
-        {{0, -1}, {0, -2}, {1,  0}, {1, -1}}
+        {{{0,  0}, {1,  0}, {1, -1}, {2, -1}}},
+        {{{1, -1}, {1, -2}, {2,  0}, {2, -1}}},
+        {{{0, -1}, {1, -1}, {1, -2}, {2, -2}}},
+        {{{0, -1}, {0, -2}, {1,  0}, {1, -1}}}
     },
     /* O Block */
     {
-        {{1,  0}, {1, -1}, {2,  0}, {2, -1}},
-        {{1,  0}, {1, -1}, {2,  0}, {2, -1}},
-        {{1,  0}, {1, -1}, {2,  0}, {2, -1}},
-        {{1,  0}, {1, -1}, {2,  0}, {2, -1}}
+        {{{1,  0}, {1, -1}, {2,  0}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {2,  0}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {2,  0}, {2, -1}}},
+        {{{1,  0}, {1, -1}, {2,  0}, {2, -1}}}
     }
 };
 
 block::block(const block_type id, const rotation_type r)
-    : x(c_initial_x), y(c_initial_y), id(id), r(r)
+    : x(c_initial_x), y(c_initial_y), id(id), r(r), kick(0)
 {
     can_be_held = true;
     data = c_block_data[id][r];
@@ -131,6 +134,32 @@ bool block::move_down(const field &field)
     }
 }
 
+int block::shift(const field &field, const int n)
+{
+    int distance = std::abs(n);
+
+    // Find the nearest filled cell (or wall) beside each cell of the block in
+    // the direction of movement using the row bitmasks.
+    for (size_t i = 0; i < data.size() && distance; ++i) {
+        const int bx = x + data[i].x;
+        const uint32_t row = field.rows[y + data[i].y];
+
+        if (n < 0) {
+            const uint32_t before = row & ((1u << bx) - 1);
+            const int wall = before ? highest_bit(before) : -1;
+            distance = std::min(distance, bx - wall - 1);
+        }
+        else {
+            const uint32_t walled = row | (1u << field.width);
+            const uint32_t after = walled & ~((2u << bx) - 1);
+            distance = std::min(distance, lowest_bit(after) - bx - 1);
+        }
+    }
+
+    x += n < 0 ? -distance : distance;
+    return distance;
+}
+
 bool block::move_n(const field& field, const int xl, const int yl)
 {
     x += xl;
@@ -170,6 +199,7 @@ bool block::rotate_right(const field &field, const wallkick::interface &wt)
     for (int test = 0; test < wt.count(id); ++test) {
         const wallkick::result wr = wt.right(id, r, test);
         if (rotate_right(field, wr.x, wr.y)) {
+            kick = test;
             return true;
         }
     }
@@ -201,6 +231,7 @@ bool block::rotate_left(const field &field, const wallkick::interface &wt)
     for (int test = 0; test < wt.count(id); ++test) {
         const wallkick::result wr = wt.left(id, r, test);
         if (rotate_left(field, wr.x, wr.y)) {
+            kick = test;
             return true;
         }
     }
@@ -208,9 +239,34 @@ bool block::rotate_left(const field &field, const wallkick::interface &wt)
     return false;
 }
 
-void block::hard_drop(const field &field)
+int block::hard_drop(const field &field)
+{
+    const int dropped = drop_distance(field);
+    y -= dropped;
+    return dropped;
+}
+
+int block::drop_distance(const field &field) const
 {
-    while (move_down(field)) {}
+    int distance = y + 1;
+
+    // Scan down each column under the block using the row bitmasks. The
+    // distance is limited by whichever cell lands first.
+    for (size_t i = 0; i < data.size(); ++i) {
+        const int bx = x + data[i].x;
+        const uint32_t bit = 1u << bx;
+
+        int d = 0;
+        for (int by = y + data[i].y - 1; by >= 0 && !(field.rows[by] & bit);
+                --by) {
+            if (++d >= distance)
+                break;
+        }
+
+        distance = std::min(distance, d);
+    }
+
+    return distance;
 }
 
 bool block::at(const int xl, const int yl) const
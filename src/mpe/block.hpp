@@ -5,7 +5,7 @@
 
 #pragma once
 
-#include <vector>
+#include <array>
 #include <memory>
 
 #include "mpe/field.hpp"
@@ -21,6 +21,9 @@ typedef int block_type;
 
 typedef int rotation_type;
 
+// Number of cells in every block
+static constexpr int c_block_cells = 4;
+
 #define bI 1
 #define bT 2
 #define bL 3
@@ -69,6 +72,10 @@ class block
     // Attempt to move the block down, returning true if success.
     bool move_down(const field &field);
 
+    // Move the block up to n cells horizontally (left if n is negative),
+    // stopping at the first obstruction. Returns the number of cells moved.
+    int shift(const field &field, const int n);
+
     // Attempt to move the block as specified by the x, y coordinates.
     bool move_n(const field &field, const int x, const int y);
 
@@ -86,8 +93,12 @@ class block
     // defined by the given wallkick class.
     bool rotate_left(const field &field, const wallkick::interface &wt);
 
-    // Attempt to drop the block all the way to the bottom of the given field.
-    void hard_drop(const field &field);
+    // Attempt to drop the block all the way to the bottom of the given field,
+    // returning the number of cells dropped.
+    int hard_drop(const field &field);
+
+    // Return the number of cells the block can fall before it lands.
+    int drop_distance(const field &field) const;
 
     // Return whether the block occupies the given x, y coordinates.
     bool at(const int x, const int y) const;
@@ -111,9 +122,13 @@ class block
     // Rotation state this block is in
     rotation_type r;
 
+    // Index of the wallkick test used by the last successful rotation
+    int kick;
+
     // A non-reference makes implementation code cleaner but rotations require
-    // an array copy. This is usually a small copy, however (max 4 points).
-    std::vector<point> data;
+    // an array copy. This is a small copy (4 points) and is stored inline, so
+    // blocks can be created and copied every tick without allocating.
+    std::array<point, c_block_cells> data;
 
     // Can the block be held?
     // This makes more sense in a higher-level API, such as engine
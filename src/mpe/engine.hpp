@@ -7,79 +7,254 @@
 #pragma once
 
 #include <algorithm>
-#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <thread>
+#include <vector>
 #include <experimental/optional>
 
 #include <mpe/block.hpp>
 #include <mpe/field.hpp>
+#include <mpe/finesse.hpp>
+#include <mpe/histogram.hpp>
 #include <mpe/keystate.hpp>
 #include <mpe/option.hpp>
 #include <mpe/randomizer/bag.hpp>
 #include <mpe/wallkick/srs.hpp>
 #include <mpe/rule/line_race.hpp>
 #include <mpe/statistics.hpp>
+#include <mpe/trace.hpp>
+#include <mpe/tspin.hpp>
 
 namespace mpe {
 
+// Gravity is measured in cells per second as 16.16 fixed point
+static const int32_t c_gravity_unit = 1 << 16;
+
+// Gravity at or above which blocks fall instantly (20 cells per 60Hz frame)
+static const int32_t c_gravity_instant = 20 * 60 * c_gravity_unit;
+
+// Parts of the engine state which have changed since the dirty flags were
+// last cleared. Changed field rows are tracked by the field itself.
+enum dirty_flag {
+    dirty_block      = 1,
+    dirty_ghost      = 2,
+    dirty_hold       = 4,
+    dirty_preview    = 8,
+    dirty_statistics = 16,
+    dirty_all        = 31,
+};
+
+// Key events which can be queued before the engine has to allocate
+static const size_t c_event_capacity = 64;
+
+// Input time recorded when no key event has been applied
+static const int64_t c_no_input = std::numeric_limits<int64_t>::max();
+
+// Pack the position, rotation and type of a block so moves can be detected
+inline uint64_t block_position(const mpe::block &block)
+{
+    return uint64_t(uint16_t(block.x)) |
+           uint64_t(uint16_t(block.y)) << 16 |
+           uint64_t(uint16_t(block.r)) << 32 |
+           uint64_t(uint16_t(block.id)) << 48;
+}
+
 class engine {
   public:
     ///----------------
     // Member Functions
     ///---
 
-    // Initialize engine with the specified options (hardcoded now)
-    engine() : running(true), ticks(0), gravity(1.0/64), gravity_count(0) {
+    // Initialize engine with the specified options (mostly hardcoded now)
+    engine(const mpe::option &option_ = mpe::option()) :
+        running(true), ticks(0), gravity(c_gravity_unit * 60 / 64),
+        gravity_count(0), arr_count(0),
+        piece_inputs(0), piece_judged(true), last_rotation(false),
+        dirty(dirty_all), input_time(c_no_input)
+    {
+        option     = option_;
         rule       = std::make_unique<mpe::rule::line_race>();
-        randomizer = std::make_unique<mpe::randomizer::bag>();
+        randomizer = std::make_unique<mpe::randomizer::bag>(option.seed);
         wallkick   = std::make_unique<mpe::wallkick::SRS>();
         block      = mpe::block(randomizer->next());
-        option     = mpe::option();
+        finesse    = std::make_unique<mpe::finesse_table>(*wallkick,
+                         field.width, field.height, field.hidden);
+
+        statistics.tickrate = option.tickrate;
+        events.reserve(c_event_capacity);
     }
 
     void update_move() {
+        MPE_TRACE_SCOPE("engine::update_move");
+
+        // Each push counts as a single input for finesse, so a held DAS is
+        // only counted once.
+        piece_inputs += keystate.is_pushed(keycode::left) +
+                        keystate.is_pushed(keycode::right);
+
         // Move in the direction that has been pressed the most recently. This
         // is much more natural behaviour when we have low DAS values.
         if (keystate.times[keycode::left] && keystate.times[keycode::right]) {
-            if (keystate.times[keycode::left] < keystate.times[keycode::right]) {
-                if (keystate.is_pressed_with_das(keycode::left, option.das)) {
-                    block.move_left(field);
-                }
+            if (keystate.times[keycode::left] < keystate.times[keycode::right])
+                update_shift(keycode::left, -1);
+            else
+                update_shift(keycode::right, 1);
+        }
+        else if (keystate.times[keycode::left]) {
+            update_shift(keycode::left, -1);
+        }
+        else if (keystate.times[keycode::right]) {
+            update_shift(keycode::right, 1);
+        }
+
+        // Soft dropped blocks may be tucked or spun into places the finesse
+        // table does not cover, so they are not judged.
+        if (keystate.is_pressed(keycode::down)) {
+            if (block.move_down(field))
+                last_rotation = false;
+            piece_judged = false;
+        }
+
+        if (keystate.is_pushed(keycode::z)) {
+            if (block.rotate_left(field, *wallkick)) {
+                last_rotation = true;
+                settle();
             }
-            else {
-                if (keystate.is_pressed_with_das(keycode::right, option.das)) {
-                    block.move_right(field);
-                }
+            piece_inputs++;
+        }
+        else if (keystate.is_pushed(keycode::x)) {
+            if (block.rotate_right(field, *wallkick)) {
+                last_rotation = true;
+                settle();
             }
+            piece_inputs++;
         }
-        else if (keystate.times[keycode::left]) {
-            if (keystate.is_pressed_with_das(keycode::left, option.das)) {
-                block.move_left(field);
+    }
+
+    // Shift the current block for a held direction key. The first tick moves
+    // a single cell, then once DAS has charged the block moves at the ARR.
+    void update_shift(const keycode key, const int direction) {
+        const int times = keystate.times[key];
+
+        if (times == 1) {
+            arr_count = 0;
+            shift(direction);
+        }
+        else if (times > option.das_ticks()) {
+            const int arr = option.arr_ticks();
+
+            if (arr == 0) {
+                shift(direction * field.width);
+            }
+            else {
+                arr_count += c_arr_unit;
+                shift(direction * (arr_count / arr));
+                arr_count %= arr;
             }
         }
-        else if (keystate.times[keycode::right]) {
-            if (keystate.is_pressed_with_das(keycode::right, option.das)) {
-                block.move_right(field);
+    }
+
+    // Shift the current block up to the given number of cells (left if
+    // negative). A successful move means a following lock can no longer be a
+    // spin.
+    void shift(const int cells) {
+        if (gravity >= c_gravity_instant) {
+            // Land after every cell so the block follows the stack surface
+            const int direction = cells < 0 ? -1 : 1;
+            for (int i = 0; i < std::abs(cells); ++i) {
+                if (!block.shift(field, direction))
+                    break;
+                last_rotation = false;
+                settle();
             }
         }
+        else if (block.shift(field, cells)) {
+            last_rotation = false;
+        }
+    }
+
+    // Move the current block down by up to the given number of cells,
+    // stopping where it lands.
+    void fall(const int cells) {
+        const int distance = std::min(cells, block.drop_distance(field));
+        if (distance > 0) {
+            block.y -= distance;
+            last_rotation = false;
+        }
+    }
+
+    // Under instant gravity a block lands as soon as it spawns or moves.
+    void settle() {
+        if (gravity >= c_gravity_instant)
+            fall(block.drop_distance(field));
+    }
+
+    // Compare the inputs used for the block just placed against the minimal
+    // number required, recording any excess as finesse faults.
+    void judge_finesse(mpe::frame_statistics &fstat) {
+        if (piece_judged) {
+            const int minimal = finesse->minimal(block.id, block.r, block.x);
+            if (minimal != -1 && piece_inputs > minimal)
+                fstat.finesse_faults += piece_inputs - minimal;
+        }
+
+        piece_inputs = 0;
+        piece_judged = true;
+    }
+
+    // Queue a key event to be applied by the first update at or after its
+    // timestamp. Events are kept in timestamp order.
+    void push_event(const mpe::key_event &event) {
+        const auto position = std::upper_bound(events.begin(), events.end(),
+            event, [](const mpe::key_event &a, const mpe::key_event &b) {
+                return a.time < b.time;
+            });
+
+        events.insert(position, event);
+    }
+
+    // Apply all queued key events up to and including the given time.
+    void apply_events(const int64_t now) {
+        size_t applied = 0;
 
-        if (keystate.is_pressed(keycode::down))
-            block.move_down(field);
+        for (; applied < events.size() && events[applied].time <= now;
+                ++applied) {
+            const mpe::key_event &event = events[applied];
 
-        if (keystate.is_pushed(keycode::z))
-            block.rotate_left(field, *wallkick);
-        else if (keystate.is_pushed(keycode::x))
-            block.rotate_right(field, *wallkick);
+            // Without a real time there is no latency to measure
+            if (now != std::numeric_limits<int64_t>::max())
+                input_latency.record((now - event.time) * 1000);
+
+            input_time = std::min(input_time, event.time);
+
+            if (event.down)
+                keystate.key_down(event.key);
+            else
+                keystate.key_up(event.key);
+        }
+
+        events.erase(events.begin(), events.begin() + applied);
     }
 
-    // Perform an update cycle based on the current keystate
+    // Perform an update cycle for the given time (in microseconds), applying
+    // any key events which occurred before it.
     // It would be nice if this was abstracted away slightly.
-    void update() {
+    void update(const int64_t now = std::numeric_limits<int64_t>::max()) {
+        MPE_TRACE_SCOPE("engine::update");
+
         // Record all the details which occur in a frame so that these can be
         // passed to any rules
         mpe::frame_statistics fstat;
 
+        const uint64_t block_before = block_position(block);
+        const uint64_t ghost_before = block_position(ghost);
+
+        // Events are applied in order, and a press is latched until the next
+        // timing update so that a tap shorter than a tick is never lost.
+        apply_events(now);
+
         // While we know the current keystate, we need to update the timings
         keystate.update_all();
 
@@ -91,6 +266,7 @@ class engine {
             if (!hold) {
                 hold = mpe::block(block.id);
                 block = randomizer->next();
+                dirty |= dirty_preview;
             }
             else {
                 // Reset block position before holding it
@@ -98,27 +274,65 @@ class engine {
                 std::swap(hold.value(), block);
             }
             block.can_be_held = false;
+            dirty |= dirty_hold | dirty_block | dirty_ghost;
+
+            // The block from hold starts with a fresh input count
+            piece_inputs = 0;
+            piece_judged = true;
+            last_rotation = false;
+            settle();
         }
 
         if (keystate.is_pushed(keycode::space)) {
-            block.hard_drop(field);
+            MPE_TRACE_SCOPE("engine::hard_drop");
+
+            if (block.hard_drop(field))
+                last_rotation = false;
+
+            switch (detect_tspin(field, block, last_rotation)) {
+              case spin_full:
+                fstat.tspin_count += 1;
+                break;
+              case spin_mini:
+                fstat.tspin_mini_count += 1;
+                break;
+              default:
+                break;
+            }
+
             field.place_block(block);
+            judge_finesse(fstat);
             fstat.blocks_placed += 1;
-            fstat.lines_cleared += field.line_clear();
+            {
+                MPE_TRACE_SCOPE("field::line_clear");
+                fstat.lines_cleared += field.line_clear();
+            }
             block = randomizer->next();
+            last_rotation = false;
+            settle();
+            dirty |= dirty_block | dirty_ghost | dirty_preview |
+                     dirty_statistics;
         }
 
-        // Apply gravity
-        gravity_count += gravity;
-        if (gravity_count > 1) {
-            float cells_to_move;
-            gravity_count = std::modf(gravity_count, &cells_to_move);
-            block.move_n(field, 0, -(int) cells_to_move);
+        // Apply gravity, keeping the fractional part for the next tick
+        if (gravity >= c_gravity_instant) {
+            settle();
+        }
+        else {
+            const int64_t per_cell = int64_t(c_gravity_unit) * option.tickrate;
+            gravity_count += gravity;
+            fall(gravity_count / per_cell);
+            gravity_count %= per_cell;
         }
 
         ghost = block;
         ghost.hard_drop(field);
 
+        if (block_position(block) != block_before)
+            dirty |= dirty_block;
+        if (block_position(ghost) != ghost_before)
+            dirty |= dirty_ghost;
+
         if (keystate.is_pushed(keycode::q) || rule->end_condition()) {
             running = false;
         }
@@ -132,6 +346,82 @@ class engine {
         ticks++;
     }
 
+    // Return the number of coming updates which would change nothing but
+    // the elapsed time, assuming no further key events arrive. These may be
+    // replaced by a single call to skip.
+    int64_t idle_ticks() const {
+        const int64_t forever = std::numeric_limits<int64_t>::max();
+
+        // The first update also lands the spawned block and places the ghost
+        if (!running || ticks == 0 || !events.empty())
+            return 0;
+
+        // A push is acted on by the next update
+        for (int i = 0; i < keycode_length; ++i) {
+            if (keystate.pending[i])
+                return 0;
+        }
+
+        // Soft drop moves every update, and a held hold key takes effect as
+        // soon as the block can be held
+        if (keystate.down[keycode::down] ||
+                (keystate.down[keycode::c] && block.can_be_held)) {
+            return 0;
+        }
+
+        int64_t idle = forever;
+
+        // A held direction next moves once DAS has charged, and then keeps
+        // moving at the ARR
+        for (const keycode key : {keycode::left, keycode::right}) {
+            if (keystate.down[key]) {
+                idle = std::min<int64_t>(idle,
+                        std::max(0, option.das_ticks() - keystate.times[key]));
+            }
+        }
+
+        // Gravity next moves the block once a whole cell has accumulated
+        if (gravity > 0 && gravity < c_gravity_instant &&
+                block.drop_distance(field) > 0) {
+            const int64_t per_cell = int64_t(c_gravity_unit) * option.tickrate;
+            const int64_t remaining = per_cell - gravity_count;
+            idle = std::min(idle, (remaining + gravity - 1) / gravity - 1);
+        }
+
+        return idle;
+    }
+
+    // Advance the game by n updates which are known to be idle (see
+    // idle_ticks), keeping game time and all timing state exactly as if
+    // each had been run.
+    void skip(const int64_t n) {
+        if (n <= 0)
+            return;
+
+        for (int i = 0; i < keycode_length; ++i) {
+            keystate.times[i] = keystate.down[i] ?
+                int(std::min<int64_t>(keystate.times[i] + n,
+                                      std::numeric_limits<int>::max())) : 0;
+        }
+
+        if (gravity < c_gravity_instant) {
+            const int64_t per_cell = int64_t(c_gravity_unit) * option.tickrate;
+            gravity_count = (gravity_count + (n % per_cell) * gravity) %
+                            per_cell;
+        }
+
+        statistics.frames_elapsed += n;
+        ticks += n;
+    }
+
+    // Forget which parts of the state have changed. This should be called
+    // once the changes have been consumed, such as after taking a snapshot.
+    void clear_dirty() {
+        dirty = 0;
+        field.dirty_rows = 0;
+        input_time = c_no_input;
+    }
+
     ///----------------
     // Member Variables
     ///---
@@ -142,11 +432,31 @@ class engine {
     // How many ticks have elapsed since this game started?
     int ticks;
 
-    // The current gravity in cells moved per frame
-    float gravity;
+    // The current gravity in cells moved per second (16.16 fixed point)
+    int32_t gravity;
+
+    // Gravity accumulated towards the next cell, in the units of gravity
+    // multiplied by the tick rate
+    int64_t gravity_count;
+
+    // Progress towards the next auto-repeat shift (24.8 fixed point ticks)
+    int32_t arr_count;
+
+    // Number of inputs used to move the current block
+    int piece_inputs;
+
+    // Should the current block be judged for finesse when placed?
+    bool piece_judged;
 
-    // The current gravity counter.
-    float gravity_count;
+    // Was the last successful move of the current block a rotation?
+    bool last_rotation;
+
+    // Parts of the state which have changed, as dirty_flag bits
+    unsigned dirty;
+
+    // Timestamp of the earliest key event applied since the dirty flags were
+    // cleared, or c_no_input
+    int64_t input_time;
 
     // The current rule we are playing with
     std::unique_ptr<mpe::rule::interface> rule;
@@ -154,6 +464,15 @@ class engine {
     // The state of the system key peripherals
     mpe::keystate keystate;
 
+    // Key events waiting to be applied, in timestamp order. Only a handful
+    // are ever waiting, so a vector (which keeps its storage as events are
+    // applied) is cheaper than a deque, which allocates as it cycles.
+    std::vector<mpe::key_event> events;
+
+    // Time from each key event to the scheduled time of the update which
+    // applied it, in nanoseconds
+    mpe::histogram input_latency;
+
     // The state of the field
     mpe::field field;
 
@@ -178,6 +497,9 @@ class engine {
     // The wallkick system used for this game
     std::unique_ptr<mpe::wallkick::interface> wallkick;
 
+    // Minimal input counts for the wallkick system and field in use
+    std::unique_ptr<mpe::finesse_table> finesse;
+
     // What type of mode is the current game?
     std::unique_ptr<mpe::rule::interface> mode;
 };
@@ -3,46 +3,107 @@
 
 #include "mpe/block.hpp"
 #include "mpe/field.hpp"
+#include "mpe/utility.hpp"
 
 namespace mpe {
 
 field::field(const int w, const int h, const int hh) :
-    width(w), height(h), hidden(hh)
+    width(w), height(h), hidden(hh), dirty_rows(~0ull), hash(0)
 {
     data.resize(width * (height + hidden));
     std::fill(data.begin(), data.end(), 0);
+    rows.resize(height + hidden);
+    std::fill(rows.begin(), rows.end(), 0);
 }
 
 int field::line_clear()
 {
     int cleared = 0;
+    int lowest = -1;
+    uint64_t previous = 0;
+    const uint32_t full = full_row();
 
     for (int y = 0; y < height + hidden; ++y) {
-        auto row_begin = data.begin() + width * y;
-        auto row_end = row_begin + width;
+        if (rows[y] == full) {
+            // Every row above the first cleared row moves, so their keys are
+            // replaced once all rows have been cleared.
+            if (lowest == -1) {
+                lowest = y;
+                previous = hash_rows(y);
+            }
+
+            auto row_begin = data.begin() + width * y;
+            auto row_end = row_begin + width;
 
-        if (std::count(row_begin, row_end, 0) == 0) {
             std::move(row_end, data.end(), row_begin);
+            std::fill(data.end() - width, data.end(), 0);
+            std::move(rows.begin() + y + 1, rows.end(), rows.begin() + y);
+            rows.back() = 0;
             cleared += 1;
             y--;
         }
     }
 
+    if (lowest != -1) {
+        hash ^= previous ^ hash_rows(lowest);
+
+        // Every row from the lowest cleared row upwards has moved
+        dirty_rows |= ~(row_bit(lowest) - 1);
+    }
+
     return cleared;
 }
 
 void field::place_block(const block &block)
 {
-    for (int i = 0; i < 4; ++i) {
-        const int x = block.x + block.data[i].x;
-        const int y = block.y + block.data[i].y;
-        data[x + width * y] = block.id + 1;
+    for (int i = 0; i < c_block_cells; ++i) {
+        fill(block.x + block.data[i].x, block.y + block.data[i].y,
+             block.id + 1);
     }
 }
 
+void field::fill(const int x, const int y, const int value)
+{
+    if (rows[y] & (1u << x))
+        return;
+
+    data[x + width * y] = value;
+    rows[y] |= 1u << x;
+    hash ^= zobrist(x, y);
+    dirty_rows |= row_bit(y);
+}
+
 int field::at(const int x, const int y) const
 {
     return data[x + width * y];
 }
 
+uint32_t field::full_row() const
+{
+    return (1u << width) - 1;
+}
+
+uint64_t field::zobrist(const int x, const int y)
+{
+    // Offset by the splitmix64 increment so that no cell has a zero key
+    return mix64(((static_cast<uint64_t>(y) << 5) | x) + 0x9e3779b97f4a7c15ull);
+}
+
+uint64_t field::row_bit(const int y)
+{
+    return 1ull << std::min(y, 63);
+}
+
+uint64_t field::hash_rows(const int from) const
+{
+    uint64_t h = 0;
+
+    for (int y = from; y < height + hidden; ++y) {
+        for (uint32_t row = rows[y]; row; row &= row - 1)
+            h ^= zobrist(lowest_bit(row), y);
+    }
+
+    return h;
+}
+
 } /* namespace mpe */
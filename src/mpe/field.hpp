@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 namespace mpe {
@@ -37,9 +38,23 @@ class field
     // Fix a block into the current field.
     void place_block(const block &block);
 
+    // Fill the cell at the specified co-ordinates with the given value,
+    // keeping the row masks, hash and dirty rows in sync. Cells which are
+    // already filled are left unchanged.
+    void fill(const int x, const int y, const int value = 1);
+
     // Return the status of the field at the specified co-ordinates
     int at(const int x, const int y) const;
 
+    // Return the mask of a completely filled row
+    uint32_t full_row() const;
+
+    // Return the Zobrist key of a filled cell at the specified co-ordinates
+    static uint64_t zobrist(const int x, const int y);
+
+    // Return the bit representing row y in dirty_rows
+    static uint64_t row_bit(const int y);
+
     ///----------------
     // Member Variables
     ///---
@@ -56,6 +71,24 @@ class field
     // Store the contents of the field. This is store in a single-dimension
     // array for allocator convenience. Field offsets are calculated manually.
     std::vector<int> data;
+
+    // Occupancy of each row as a bitmask, where bit x is set if the cell at
+    // column x is filled. This is kept in sync with data and limits the field
+    // width to 30 columns.
+    std::vector<uint32_t> rows;
+
+    // Rows which have changed since this was last cleared, as a bitmask
+    // indexed by row_bit. Rows above the 64th share the highest bit. This is
+    // only ever set by the field, and is cleared by its owner.
+    uint64_t dirty_rows;
+
+    // Zobrist hash of the filled cells. Cell colours are ignored. This is
+    // updated incrementally as blocks are placed and lines are cleared.
+    uint64_t hash;
+
+  private:
+    // Return the combined Zobrist keys of all filled cells from row y upwards
+    uint64_t hash_rows(const int y) const;
 };
 
 } // namespace mpe
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/finesse.hpp"
+
+namespace mpe {
+
+// Blocks can be positioned to the left of the field since the leftmost cell
+// of a block is not always at its origin.
+static const int c_x_margin = 2;
+
+// The furthest distance a wallkick can move a block upwards.
+static const int c_max_kick = 2;
+
+// The key used to perform each input
+static const keycode c_input_keys[finesse_input_length] = {
+    keycode::left, keycode::right, keycode::left, keycode::right,
+    keycode::z, keycode::x, keycode::down, keycode::down
+};
+
+// Return a key identifying the cells occupied by a block, independent of the
+// rotation used to reach them.
+static unsigned footprint(const block &b)
+{
+    int minx = b.x + b.data[0].x, miny = b.y + b.data[0].y;
+    for (const auto &p : b.data) {
+        minx = std::min(minx, b.x + p.x);
+        miny = std::min(miny, b.y + p.y);
+    }
+
+    unsigned mask = 0;
+    for (const auto &p : b.data)
+        mask |= 1u << ((b.y + p.y - miny) * 4 + (b.x + p.x - minx));
+
+    return (mask << 16) | (miny << 8) | (minx + c_x_margin);
+}
+
+finesse_table::finesse_table(const wallkick::interface &wallkick,
+                             const int width, const int height,
+                             const int hidden)
+    : wallkick(wallkick), columns(width + c_x_margin)
+{
+    const field empty(width, height, hidden);
+
+    counts.assign(7 * 4 * columns, -1);
+    sequences.resize(7 * 4 * columns);
+
+    for (block_type id = 0; id < 7; ++id) {
+        search(empty, block(id), false);
+
+        // The queue is in order of input count, so the first state found for
+        // each placement is minimal.
+        std::vector<unsigned> prints(4 * columns, 0);
+        for (const int s : queue) {
+            block b = state(id, s);
+            const int i = index(id, b.r, b.x);
+            if (counts[i] != -1)
+                continue;
+
+            sequences[i] = trace(s);
+            counts[i] = sequences[i].size();
+
+            b.hard_drop(empty);
+            prints[b.r * columns + b.x + c_x_margin] = footprint(b);
+        }
+
+        // Placements covering the same cells share the cheapest sequence.
+        for (int a = 0; a < 4 * columns; ++a) {
+            for (int b = 0; b < 4 * columns; ++b) {
+                const int ia = id * 4 * columns + a;
+                const int ib = id * 4 * columns + b;
+
+                if (!prints[a] || prints[a] != prints[b] ||
+                        counts[ia] <= counts[ib]) {
+                    continue;
+                }
+
+                counts[ia] = counts[ib];
+                sequences[ia] = sequences[ib];
+            }
+        }
+    }
+}
+
+int finesse_table::minimal(const block_type id, const rotation_type r,
+                           const int x) const
+{
+    if (x + c_x_margin < 0 || x + c_x_margin >= columns)
+        return -1;
+
+    return counts[index(id, r, x)];
+}
+
+const std::vector<finesse_input>&
+finesse_table::inputs(const block_type id, const rotation_type r,
+                      const int x) const
+{
+    static const std::vector<finesse_input> none;
+
+    if (minimal(id, r, x) == -1)
+        return none;
+
+    return sequences[index(id, r, x)];
+}
+
+bool finesse_table::path(const field &field, const block &start,
+                         const block &target, std::vector<finesse_input> &out)
+{
+    const unsigned goal = footprint(target);
+    const block spawn(start.id);
+
+    // The table assumes the block starts in its spawn column and rotation.
+    if (start.x == spawn.x && start.r == spawn.r) {
+        block b = start;
+        const auto &in = inputs(target.id, target.r, target.x);
+
+        for (const finesse_input input : in)
+            apply(field, b, input);
+        b.hard_drop(field);
+
+        if (!in.empty() && footprint(b) == goal) {
+            out = in;
+            return true;
+        }
+    }
+
+    search(field, start, true);
+
+    for (const int s : queue) {
+        block b = state(start.id, s);
+        b.hard_drop(field);
+
+        if (footprint(b) == goal) {
+            out = trace(s);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<scheduled_key>
+finesse_table::timeline(const field &field, const block &start,
+                        const std::vector<finesse_input> &in,
+                        const mpe::option &option) const
+{
+    const int das = option.das_ticks();
+    const int arr = option.arr_ticks();
+
+    std::vector<scheduled_key> keys;
+    block b = start;
+    int tick = 0;
+    int previous = -1;
+
+    for (const finesse_input input : in) {
+        const keycode key = c_input_keys[input];
+
+        // A key must be released for a tick before it can be pushed again.
+        if (key == previous)
+            tick += 1;
+
+        const int moved = apply(field, b, input);
+
+        // A held direction moves once on the first tick and then at the ARR
+        // after the DAS delay, while soft drop moves every tick.
+        int held = 1;
+        if ((input == das_left || input == das_right) && moved > 1) {
+            const int64_t repeat = int64_t(moved - 1) * arr;
+            held = das + (arr ? (repeat + c_arr_unit - 1) / c_arr_unit : 1);
+        }
+        else if (input == soft_drop)
+            held = std::max(moved, 1);
+
+        keys.push_back({tick, key, true});
+        keys.push_back({tick + held, key, false});
+        tick += held;
+        previous = key;
+    }
+
+    keys.push_back({tick, keycode::space, true});
+    keys.push_back({tick + 1, keycode::space, false});
+
+    std::stable_sort(keys.begin(), keys.end(),
+        [](const scheduled_key &a, const scheduled_key &b) {
+            return a.tick < b.tick;
+        });
+
+    return keys;
+}
+
+int finesse_table::apply(const field &field, block &b,
+                         const finesse_input input) const
+{
+    int moved = 0;
+
+    switch (input) {
+      case tap_left:
+        return b.move_left(field);
+      case tap_right:
+        return b.move_right(field);
+      case das_left:
+        while (b.move_left(field))
+            moved++;
+        return moved;
+      case das_right:
+        while (b.move_right(field))
+            moved++;
+        return moved;
+      case rotate_ccw:
+        return b.rotate_left(field, wallkick);
+      case rotate_cw:
+        return b.rotate_right(field, wallkick);
+      case tap_down:
+        return b.move_down(field);
+      case soft_drop:
+        while (b.move_down(field))
+            moved++;
+        return moved;
+      default:
+        return 0;
+    }
+}
+
+void finesse_table::search(const field &field, const block &start,
+                           const bool drops)
+{
+    search_width = field.width + c_x_margin;
+    search_rows = field.height + field.hidden;
+
+    const size_t states = 4 * search_rows * search_width;
+    parent.assign(states, -1);
+    via.resize(states);
+    queue.clear();
+
+    if (start.y >= search_rows || block(start).collision(field))
+        return;
+
+    search_origin = (start.r * search_rows + start.y) * search_width +
+                    start.x + c_x_margin;
+    parent[search_origin] = search_origin;
+    queue.push_back(search_origin);
+
+    const int last = drops ? finesse_input_length : tap_down;
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const int s = queue[head];
+        const block from = state(start.id, s);
+
+        for (int input = 0; input < last; ++input) {
+            if ((input == rotate_ccw || input == rotate_cw) &&
+                    from.y + c_max_kick >= search_rows) {
+                continue;
+            }
+
+            block b = from;
+            if (!apply(field, b, static_cast<finesse_input>(input)))
+                continue;
+
+            const int n = (b.r * search_rows + b.y) * search_width +
+                          b.x + c_x_margin;
+            if (b.y < search_rows && parent[n] == -1) {
+                parent[n] = s;
+                via[n] = input;
+                queue.push_back(n);
+            }
+        }
+    }
+}
+
+std::vector<finesse_input> finesse_table::trace(int s) const
+{
+    std::vector<finesse_input> in;
+
+    for (; s != search_origin; s = parent[s])
+        in.push_back(static_cast<finesse_input>(via[s]));
+
+    std::reverse(in.begin(), in.end());
+    return in;
+}
+
+block finesse_table::state(const block_type id, const int s) const
+{
+    block b(id, s / (search_rows * search_width));
+    b.y = (s / search_width) % search_rows;
+    b.x = s % search_width - c_x_margin;
+    return b;
+}
+
+int finesse_table::index(const block_type id, const rotation_type r,
+                         const int x) const
+{
+    return (id * 4 + r) * columns + x + c_x_margin;
+}
+
+} // namespace mpe
@@ -0,0 +1,130 @@
+///
+// finesse.hpp
+//
+// Finesse is the minimal number of inputs needed to move a block into its
+// final position. This provides a table of minimal input sequences for every
+// rotation and column on an empty field, along with a search for the inputs
+// needed to reach placements that the table cannot (tucks, spins, or paths
+// blocked by the field).
+//
+// Input sequences can be converted into key press timelines which respect the
+// DAS and ARR settings of a game, allowing them to be replayed through a
+// keystate.
+
+#pragma once
+
+#include <vector>
+
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/keystate.hpp"
+#include "mpe/option.hpp"
+#include "mpe/wallkick/interface.hpp"
+
+namespace mpe {
+
+// A single input as counted for finesse. DAS inputs hold a direction until the
+// block can move no further, and a soft drop holds down until the block lands.
+enum finesse_input {
+    tap_left, tap_right, das_left, das_right, rotate_ccw, rotate_cw,
+    tap_down, soft_drop,
+    finesse_input_length,
+};
+
+// A key transition scheduled a number of ticks after a sequence starts.
+struct scheduled_key
+{
+    int tick;
+    keycode key;
+    bool down;
+};
+
+class finesse_table
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    // Build the table for every block on an empty field of the given size.
+    finesse_table(const wallkick::interface &wallkick,
+                  const int width = c_default_width,
+                  const int height = c_default_height,
+                  const int hidden = c_default_hidden);
+
+    // Return the minimal number of inputs required to hard drop the given
+    // block id at rotation r and column x on an empty field. Rotations that
+    // cover the same cells are treated as equal. Returns -1 if unreachable.
+    int minimal(const block_type id, const rotation_type r, const int x) const;
+
+    // Return the minimal input sequence for the given placement. The sequence
+    // is empty if the placement is unreachable.
+    const std::vector<finesse_input>& inputs(const block_type id,
+                                             const rotation_type r,
+                                             const int x) const;
+
+    // Find the inputs which move the start block so that a hard drop leaves
+    // it in the same cells as target. The table is used when its sequence
+    // works on this field, otherwise the field is searched. Returns false if
+    // the target cannot be reached.
+    bool path(const field &field, const block &start, const block &target,
+              std::vector<finesse_input> &out);
+
+    // Convert an input sequence for the start block into a key timeline,
+    // ending with a hard drop. DAS inputs are held long enough to reach the
+    // wall (or obstruction) with the DAS and ARR settings of the option.
+    std::vector<scheduled_key> timeline(const field &field,
+                                        const block &start,
+                                        const std::vector<finesse_input> &in,
+                                        const mpe::option &option) const;
+
+  private:
+    // Apply an input to a block, returning the number of cells moved (or 1
+    // for a successful rotation).
+    int apply(const field &field, block &b, const finesse_input input) const;
+
+    // Search all states reachable from the start block with the minimal
+    // number of inputs. Drops are only considered if drops is true.
+    void search(const field &field, const block &start, const bool drops);
+
+    // Return the inputs used to reach state s in the last search.
+    std::vector<finesse_input> trace(int s) const;
+
+    // Return the block at search state s.
+    block state(const block_type id, const int s) const;
+
+    // Return the table index of the given placement.
+    int index(const block_type id, const rotation_type r, const int x) const;
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Wallkicks applied when rotating
+    const wallkick::interface &wallkick;
+
+    // Number of columns in the table (including the left margin)
+    int columns;
+
+    // Minimal input counts, indexed by block, rotation and column
+    std::vector<int> counts;
+
+    // Minimal input sequences, indexed as counts
+    std::vector<std::vector<finesse_input>> sequences;
+
+    // Search state dimensions
+    int search_width;
+    int search_rows;
+    int search_origin;
+
+    // The state each search state was first reached from (-1 if unvisited)
+    std::vector<int> parent;
+
+    // The input used to reach each search state
+    std::vector<char> via;
+
+    // Breadth-first search queue
+    std::vector<int> queue;
+};
+
+} // namespace mpe
@@ -0,0 +1,193 @@
+///
+// histogram.hpp
+//
+// A fixed-size latency histogram in the style of HdrHistogram. Values are
+// durations in nanoseconds.
+//
+// Values below 2 * c_sub_buckets each have their own bucket. Above that, every
+// power of two range is split into c_sub_buckets equal buckets, so a bucket
+// never spans more than 1/c_sub_buckets (about 3%) of its values. All buckets
+// live in a fixed array, so recording is a few instructions and never
+// allocates, and histograms can be merged by adding their counts.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+
+namespace mpe {
+
+// Buckets in each power of two range (must be a power of two)
+static constexpr int c_sub_bucket_bits = 5;
+static constexpr int64_t c_sub_buckets = 1 << c_sub_bucket_bits;
+
+// Values from 2^c_histogram_bits (about 4.9 hours) upwards are clamped
+static constexpr int c_histogram_bits = 44;
+
+// The percentiles reported by dump
+static constexpr double c_dump_percentiles[] = {50, 99, 99.9};
+
+class histogram
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    histogram()
+    {
+        reset();
+    }
+
+    // Record a single value. Negative values are recorded as 0.
+    void record(int64_t value)
+    {
+        value = std::min(std::max<int64_t>(value, 0), c_max_value);
+
+        counts[index(value)] += 1;
+        total += 1;
+        sum += value;
+        smallest = std::min(smallest, value);
+        largest = std::max(largest, value);
+    }
+
+    // Add all values recorded by another histogram.
+    void merge(const histogram &other)
+    {
+        for (size_t i = 0; i < counts.size(); ++i)
+            counts[i] += other.counts[i];
+
+        total += other.total;
+        sum += other.sum;
+        smallest = std::min(smallest, other.smallest);
+        largest = std::max(largest, other.largest);
+    }
+
+    // Forget all recorded values.
+    void reset()
+    {
+        counts.fill(0);
+        total = 0;
+        sum = 0;
+        smallest = std::numeric_limits<int64_t>::max();
+        largest = 0;
+    }
+
+    // Return the number of values recorded
+    int64_t count() const
+    {
+        return total;
+    }
+
+    // Return the smallest value recorded, or 0 if there are none
+    int64_t min() const
+    {
+        return total ? smallest : 0;
+    }
+
+    // Return the largest value recorded, or 0 if there are none
+    int64_t max() const
+    {
+        return largest;
+    }
+
+    // Return the mean of all values recorded, or 0 if there are none
+    double mean() const
+    {
+        return total ? double(sum) / total : 0;
+    }
+
+    // Return a value which at least p percent of recorded values are less
+    // than or equal to. This is the upper bound of the bucket containing that
+    // rank, so it overestimates by at most the bucket width.
+    int64_t percentile(const double p) const
+    {
+        if (!total)
+            return 0;
+
+        const int64_t rank = std::max<int64_t>(1,
+                std::ceil(std::min(p, 100.0) / 100 * total));
+
+        int64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(upper_bound(i), largest);
+        }
+
+        return largest;
+    }
+
+    // Print a one line summary in microseconds.
+    void dump(const char *name, FILE *fd = stdout) const
+    {
+        std::fprintf(fd, "%s:", name);
+        for (const double p : c_dump_percentiles)
+            std::fprintf(fd, " p%g %.1fus", p, percentile(p) / 1000.0);
+        std::fprintf(fd, " max %.1fus (%lld samples)\n", max() / 1000.0,
+                (long long) count());
+    }
+
+    // Print the summary as a JSON object, with values in nanoseconds.
+    void dump_json(FILE *fd = stdout) const
+    {
+        std::fprintf(fd, "{\"count\":%lld,\"min\":%lld,\"mean\":%.1f",
+                (long long) count(), (long long) min(), mean());
+        for (const double p : c_dump_percentiles)
+            std::fprintf(fd, ",\"p%g\":%lld", p, (long long) percentile(p));
+        std::fprintf(fd, ",\"max\":%lld}", (long long) max());
+    }
+
+  private:
+    // The largest value which can be recorded
+    static constexpr int64_t c_max_value =
+        (int64_t(1) << c_histogram_bits) - 1;
+
+    // Buckets covering values 0 to c_max_value
+    static constexpr size_t c_bucket_count =
+        (c_histogram_bits - c_sub_bucket_bits + 1) * c_sub_buckets;
+
+    // Return the bucket holding the given value
+    static size_t index(const int64_t value)
+    {
+        if (value < 2 * c_sub_buckets)
+            return value;
+
+        const int shift = 63 - __builtin_clzll(value) - c_sub_bucket_bits;
+        return shift * c_sub_buckets + (value >> shift);
+    }
+
+    // Return the largest value held by the given bucket
+    static int64_t upper_bound(const size_t i)
+    {
+        if (i < size_t(2 * c_sub_buckets))
+            return i;
+
+        const int shift = i / c_sub_buckets - 1;
+        const int64_t sub = i - shift * c_sub_buckets;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Number of values recorded in each bucket
+    std::array<int64_t, c_bucket_count> counts;
+
+    // Number of values recorded
+    int64_t total;
+
+    // Sum of the values recorded
+    int64_t sum;
+
+    // Smallest and largest values recorded
+    int64_t smallest;
+    int64_t largest;
+};
+
+} // namespace mpe
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 
 #include "mpe/utility.hpp"
 
@@ -21,6 +22,15 @@ enum keycode {
     keycode_length,
 };
 
+// A timestamped change in the state of a key. Times are in microseconds on a
+// monotonic clock shared with whoever is ticking the engine.
+struct key_event
+{
+    int64_t time;
+    keycode key;
+    bool down;
+};
+
 class keystate
 {
   public:
@@ -29,12 +39,15 @@ class keystate
     ///---
     keystate() {
         std::fill(down.begin(), down.end(), false);
+        std::fill(pending.begin(), pending.end(), false);
         std::fill(times.begin(), times.end(), 0);
     }
 
     // Change the specified keys state to pressed
     void key_down(const keycode key)
     {
+        if (!down[key])
+            pending[key] = true;
         down[key] = true;
     }
 
@@ -44,14 +57,19 @@ class keystate
         down[key] = false;
     }
 
-    // Update all key timings
+    // Update all key timings. A key pressed since the last update is always
+    // seen as pushed, even if it has already been released again.
     void update_all(void)
     {
         for (int i = 0; i < keycode_length; ++i) {
-            if (down[i])
+            if (pending[i])
+                times[i] = 1;
+            else if (down[i])
                 times[i]++;
             else
                 times[i] = 0;
+
+            pending[i] = false;
         }
     }
 
@@ -87,6 +105,9 @@ class keystate
     //  - true  => down
     std::array<bool, keycode_length> down;
 
+    // Store whether each key has been pressed since the last update
+    std::array<bool, keycode_length> pending;
+
     // Store how long each key has been pressed for in terms of ticks
     std::array<int, keycode_length> times;
 };
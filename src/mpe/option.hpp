@@ -9,12 +9,37 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace mpe {
 
+// Number of microseconds in a second
+static const int64_t c_microseconds = 1000000;
+
+// ARR is converted to ticks per cell as 24.8 fixed point. The coarse fraction
+// absorbs the rounding in microsecond ARR values, so that one 60Hz frame
+// (16667us) is exactly one tick at 60Hz.
+static const int c_arr_unit = 1 << 8;
+
 class option
 {
   public:
-    option() : are(0), das(8) {}
+    option() :
+        are(0), tickrate(60), das(133333), arr(16667), seed(0)
+    {}
+
+    // Return the DAS delay in ticks.
+    int das_ticks() const
+    {
+        return (int64_t(das) * tickrate + c_microseconds / 2) / c_microseconds;
+    }
+
+    // Return the ARR in ticks per cell (24.8 fixed point).
+    int arr_ticks() const
+    {
+        return (int64_t(arr) * tickrate * c_arr_unit + c_microseconds / 2) /
+               c_microseconds;
+    }
 
     ///----------------
     // Member Variables
@@ -22,7 +47,22 @@ class option
 
     int are;
 
+    // Number of engine updates per second. This is independent of the rate
+    // at which frames are drawn.
+    int tickrate;
+
+    // Time (in microseconds) a direction must be held before it begins to
+    // repeat.
     int das;
+
+    // Time (in microseconds) taken to shift each cell once DAS has charged.
+    // Values shorter than a tick shift multiple cells per tick, and an ARR of
+    // 0 shifts to the wall immediately.
+    int arr;
+
+    // Seed used for the randomizer. A seed of 0 requests a random seed, any
+    // other value gives a reproducible piece sequence.
+    unsigned seed;
 };
 
 } // namespace mpe
@@ -11,10 +11,12 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <numeric>
 
 #include "mpe/randomizer/interface.hpp"
 #include "mpe/block.hpp"
+#include "mpe/trace.hpp"
 
 namespace mpe::randomizer {
 
@@ -22,10 +24,12 @@ namespace mpe::randomizer {
 // any multiple of 7 easily via templates.
 constexpr int N = 7;
 
+static_assert(N <= c_max_preview, "the whole bag must fit in the preview");
+
 class bag : public interface
 {
   public:
-    bag() : index(0)
+    bag(const unsigned seed = 0) : interface(seed), index(0)
     {
         shuffle(0);
         shuffle(N);
@@ -41,6 +45,7 @@ class bag : public interface
 
     block next()
     {
+        MPE_TRACE_SCOPE("randomizer::next");
         block random_block = block(static_cast<block_type>(data[index]));
         index = (index + 1) % (2*N);
 
@@ -56,11 +61,12 @@ class bag : public interface
         return N;
     }
 
-    std::vector<int> preview_pieces()
+    preview preview_pieces()
     {
-        std::vector<int> previews;
+        preview previews;
         for (int i = 0; i < N; ++i)
-            previews.push_back(data[(index + i) % (2*N)]);
+            previews.ids[i] = data[(index + i) % (2*N)];
+        previews.count = N;
 
         return previews;
     }
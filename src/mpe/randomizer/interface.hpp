@@ -6,12 +6,31 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <random>
 
 #include "mpe/block.hpp"
 
 namespace mpe::randomizer {
 
+// Most preview pieces provided by any randomizer
+static constexpr int c_max_preview = 7;
+
+// The next incoming pieces, in order. This is a fixed-size value so that it
+// can be read every tick without allocating.
+struct preview
+{
+    preview() : count(0) {}
+
+    const int* begin() const { return ids.data(); }
+    const int* end() const { return ids.data() + count; }
+    size_t size() const { return count; }
+
+    std::array<int, c_max_preview> ids;
+    int count;
+};
+
 class interface
 {
   public:
@@ -24,16 +43,17 @@ class interface
     // Return the maximum number of preview pieces that can be shown
     virtual int preview_count() const = 0;
 
-    // Return a vector of the next incoming pieces. The length of this vector
-    // will be the size returned by previewCount
-    virtual std::vector<int> preview_pieces() = 0;
+    // Return the next incoming pieces. The number of pieces will be the size
+    // returned by preview_count.
+    virtual preview preview_pieces() = 0;
 
   protected:
     // Implicitly called by each subclass. It is usually required for a
-    // randomizer to have access to a 0-6 int distribution.
-    interface() {
+    // randomizer to have access to a 0-6 int distribution. A seed of 0 will
+    // seed the generator from a random device.
+    interface(const unsigned seed = 0) {
         std::random_device rd;
-        generator = std::mt19937(rd());
+        generator = std::mt19937(seed ? seed : rd());
         dist = std::uniform_int_distribution<int>(0, 6);
     }
 
@@ -7,14 +7,18 @@
 
 #include "mpe/randomizer/interface.hpp"
 #include "mpe/block.hpp"
+#include "mpe/trace.hpp"
 
 namespace mpe::randomizer {
 
 class memoryless : public interface
 {
   public:
+    memoryless(const unsigned seed = 0) : interface(seed) {}
+
     block next()
     {
+        MPE_TRACE_SCOPE("randomizer::next");
         return random_block();
     }
 
@@ -23,9 +27,9 @@ class memoryless : public interface
         return 0;
     }
 
-    std::vector<int> preview_pieces()
+    preview preview_pieces()
     {
-        return std::vector<int>();
+        return preview();
     }
 };
 
@@ -0,0 +1,211 @@
+///
+// scheduler.hpp
+//
+// Keeps a fixed rate tick timeline for the main loop. Tick deadlines are
+// computed from the start time rather than from the end of the previous tick,
+// so timing error never accumulates.
+//
+// Waiting is split in two: the thread sleeps until shortly before a deadline,
+// then spins for the remainder, since sleeps commonly overshoot by far more
+// than a tick can tolerate. If the loop falls behind, every missed tick is
+// reported as due so the caller can catch up. This is bounded, and ticks
+// beyond the bound are dropped so that one long stall does not cause a burst
+// of catch-up updates.
+//
+// The lateness of each wake-up against its deadline is recorded as jitter,
+// and kept in a histogram as the sleep overshoot.
+//
+// When the caller knows that the next few ticks will change nothing, it can
+// pass their number to wait. The scheduler then sleeps through them in one
+// go, waking early if the caller's sleep function is interrupted (such as by
+// input arriving), and reports every tick that passed as due. These are never
+// dropped, so game time stays exact however long the sleep was.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "mpe/histogram.hpp"
+
+namespace mpe {
+
+// Time before a deadline at which sleeping stops and spinning begins
+static constexpr std::chrono::microseconds c_default_spin(1000);
+
+// Maximum number of ticks reported as due by a single wait
+static constexpr int c_default_catch_up = 5;
+
+class scheduler
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+
+    ///----------------
+    // Member Functions
+    ///---
+
+    // Create a scheduler with one tick per period, starting now.
+    template <typename Duration>
+    scheduler(const Duration period,
+              const clock::duration spin = c_default_spin,
+              const int max_catch_up = c_default_catch_up) :
+        period(std::chrono::duration_cast<clock::duration>(period)),
+        spin(spin), max_catch_up(max_catch_up),
+        start(clock::now()), next(0), first(0), gap_at(0), gap(0),
+        dropped(0), waits(0), jitter_last(0), jitter_max(0), jitter_total(0)
+    {}
+
+    // Wait until the next tick is due, returning the number of ticks which
+    // should now be run (at least 1 and at most the catch-up bound).
+    int64_t wait()
+    {
+        return wait(0, [](const clock::time_point until) {
+            std::this_thread::sleep_until(until);
+        });
+    }
+
+    // Wait as above, but first sleep through up to idle ticks which are known
+    // to change nothing. sleep(until) must block until the given time, but
+    // may return early to end the idle period. Every tick passed while idle
+    // is included in the result.
+    template <typename Sleep>
+    int64_t wait(const int64_t idle, const Sleep &sleep)
+    {
+        int64_t covered = 0;
+
+        if (idle > 0) {
+            sleep(time(next + idle) - spin);
+
+            // Only the ticks which have passed count as idle. If the sleep
+            // was ended early, the tick after them is the next to run.
+            const clock::time_point now = clock::now();
+            covered = now < time(next) ? 0 :
+                std::min(idle, 1 + (now - time(next)) / period);
+        }
+
+        const clock::time_point deadline = time(next + covered);
+
+        std::this_thread::sleep_until(deadline - spin);
+        while (clock::now() < deadline) {}
+
+        const clock::time_point now = clock::now();
+        const int64_t late = std::chrono::duration_cast<
+            std::chrono::microseconds>(now - deadline).count();
+
+        overshoot.record(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(now - deadline).count());
+
+        waits += 1;
+        jitter_last = late;
+        jitter_max = std::max(jitter_max, late);
+        jitter_total += late;
+
+        // Ticks beyond the catch-up bound are dropped from just after the
+        // idle ticks, so the ticks reported last are the most recent
+        int64_t due = 1 + (now - deadline) / period;
+        gap_at = covered;
+        gap = 0;
+        if (due > max_catch_up) {
+            gap = due - max_catch_up;
+            dropped += gap;
+            due = max_catch_up;
+        }
+
+        first = next;
+        next += covered + gap + due;
+        return covered + due;
+    }
+
+    // Return the scheduled time of the i'th tick returned by the last wait.
+    clock::time_point tick_time(const int64_t i) const
+    {
+        return time(first + i + (i < gap_at ? 0 : gap));
+    }
+
+    // Return the scheduled time of the i'th tick returned by the last wait,
+    // in microseconds since the clock epoch.
+    int64_t tick_time_us(const int64_t i) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            tick_time(i).time_since_epoch()).count();
+    }
+
+    // Return how late (in microseconds) the last wait woke up
+    int64_t last_jitter() const
+    {
+        return jitter_last;
+    }
+
+    // Return the largest lateness (in microseconds) of any wait
+    int64_t max_jitter() const
+    {
+        return jitter_max;
+    }
+
+    // Return the mean lateness (in microseconds) of all waits
+    double mean_jitter() const
+    {
+        return waits ? double(jitter_total) / waits : 0;
+    }
+
+    // Return the distribution of how late each wait woke up
+    const histogram& overshoot_histogram() const
+    {
+        return overshoot;
+    }
+
+    // Return the number of ticks dropped for exceeding the catch-up bound
+    int64_t dropped_ticks() const
+    {
+        return dropped;
+    }
+
+  private:
+    // Return the scheduled time of tick n
+    clock::time_point time(const int64_t n) const
+    {
+        return start + n * period;
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Time between ticks
+    const clock::duration period;
+
+    // Time spent spinning before each deadline
+    const clock::duration spin;
+
+    // Maximum number of ticks returned by a single wait
+    const int max_catch_up;
+
+    // Time of tick 0
+    const clock::time_point start;
+
+    // Index of the next tick which has not been run
+    int64_t next;
+
+    // Index of the first tick returned by the last wait
+    int64_t first;
+
+    // Position within the ticks returned by the last wait at which ticks
+    // were dropped, and how many
+    int64_t gap_at;
+    int64_t gap;
+
+    // Number of ticks dropped
+    int64_t dropped;
+
+    // Jitter measurements
+    int64_t waits;
+    int64_t jitter_last;
+    int64_t jitter_max;
+    int64_t jitter_total;
+    histogram overshoot;
+};
+
+} // namespace mpe
@@ -0,0 +1,112 @@
+///
+// snapshot.hpp
+//
+// A copy of the engine state needed to draw a frame. Snapshots are captured
+// by the simulation after each tick and handed to a renderer, which can then
+// draw without touching (or locking) the engine itself.
+//
+// Capturing reuses the storage of the previous capture, so once a snapshot
+// has been filled no further allocation is needed for a field of the same
+// size.
+//
+// Each snapshot records what changed since the previous one so a renderer
+// can redraw only those parts. If a snapshot is replaced before it is drawn,
+// its changes must be merged into the next capture or they would be lost.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "mpe/block.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/field.hpp"
+#include "mpe/statistics.hpp"
+
+namespace mpe {
+
+// Maximum number of preview pieces stored in a snapshot
+static constexpr int c_snapshot_preview = 7;
+
+struct snapshot
+{
+    snapshot() :
+        has_hold(false), hold(0), preview_count(0), ticks(0), running(true),
+        dirty(dirty_all), dirty_rows(~0ull), input_time(c_no_input)
+    {}
+
+    // Copy the drawable state of the given engine, along with what has
+    // changed since the engine dirty flags were cleared. If merge is set, the
+    // changes already recorded in this snapshot are kept as well.
+    void capture(const mpe::engine &engine, const bool merge = false)
+    {
+        dirty = engine.dirty | (merge ? dirty : 0);
+        dirty_rows = engine.field.dirty_rows | (merge ? dirty_rows : 0);
+        input_time = merge ? std::min(input_time, engine.input_time) :
+                             engine.input_time;
+
+        field = engine.field;
+        block = engine.block;
+        ghost = engine.ghost;
+
+        has_hold = bool(engine.hold);
+        hold = has_hold ? engine.hold->id : 0;
+
+        const auto pieces = engine.randomizer->preview_pieces();
+        preview_count = std::min<int>(pieces.size(), c_snapshot_preview);
+        std::copy_n(pieces.begin(), preview_count, preview.begin());
+
+        statistics = engine.statistics;
+        ticks = engine.ticks;
+        running = engine.running;
+    }
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // The state of the field
+    mpe::field field;
+
+    // The current block in play
+    mpe::block block;
+
+    // Ghost piece
+    mpe::block ghost;
+
+    // Is a block being held?
+    bool has_hold;
+
+    // The id of the held block (if has_hold is set)
+    block_type hold;
+
+    // Number of valid entries in preview
+    int preview_count;
+
+    // Ids of the upcoming blocks, next first
+    std::array<block_type, c_snapshot_preview> preview;
+
+    // Statistics for the current game
+    mpe::statistics statistics;
+
+    // How many ticks had elapsed when this snapshot was taken
+    int ticks;
+
+    // Was the game still running?
+    bool running;
+
+    // Parts of the state which changed since the previous snapshot, as
+    // dirty_flag bits
+    unsigned dirty;
+
+    // Field rows which changed since the previous snapshot
+    uint64_t dirty_rows;
+
+    // Timestamp (in microseconds) of the earliest key event applied since
+    // the previous snapshot, or c_no_input. The frame drawing this snapshot
+    // is the first to show the effect of that event.
+    int64_t input_time;
+};
+
+} // namespace mpe
@@ -0,0 +1,81 @@
+///
+// spsc_queue.hpp
+//
+// A fixed-capacity ring buffer for passing values from exactly one producer
+// thread to exactly one consumer thread without locks.
+//
+// Each side owns one index and only reads the other. The producer publishes a
+// value by storing the new tail with release ordering after writing the slot,
+// and the consumer frees a slot by storing the new head after reading it. The
+// indices live on separate cache lines so the two threads do not contend.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace mpe {
+
+template <typename T, size_t N>
+class spsc_queue
+{
+    static_assert(N && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    spsc_queue() : head(0), tail(0) {}
+
+    // Append a value to the queue, returning false if it is full. Must only
+    // be called from the producer thread.
+    bool push(const T &value)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+
+        slots[t & (N - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Remove the oldest value from the queue into out, returning false if it
+    // is empty. Must only be called from the consumer thread.
+    bool pop(T &out)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        out = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Return whether the queue is empty. The result may be stale as soon as
+    // it is returned if the other thread is active.
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) ==
+               tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Index of the next value to pop (written by the consumer)
+    alignas(64) std::atomic<size_t> head;
+
+    // Index of the next slot to push to (written by the producer)
+    alignas(64) std::atomic<size_t> tail;
+
+    // Value storage
+    alignas(64) std::array<T, N> slots;
+};
+
+} // namespace mpe
@@ -18,7 +18,9 @@ struct frame_statistics
     frame_statistics() :
         blocks_placed(0),
         lines_cleared(0),
-        tspin_count(0)
+        tspin_count(0),
+        tspin_mini_count(0),
+        finesse_faults(0)
     {}
 
     // How many blocks have been placed this frame
@@ -29,6 +31,12 @@ struct frame_statistics
 
     // How many t-spins occurred this frame
     int tspin_count;
+
+    // How many t-spin minis occurred this frame
+    int tspin_mini_count;
+
+    // How many inputs over the minimum were used for blocks placed this frame
+    int finesse_faults;
 };
 
 ///
@@ -42,8 +50,10 @@ struct statistics
         pps(0),
         ppm(0),
         frames_elapsed(0),
+        tickrate(60),
         lines_cleared(0),
-        tspin_count(0)
+        tspin_count(0),
+        tspin_mini_count(0)
     {}
 
     // Add a frame statistics object to the running total
@@ -51,21 +61,31 @@ struct statistics
     {
         blocks_placed += fstat.blocks_placed;
         lines_cleared += fstat.lines_cleared;
+        tspin_count += fstat.tspin_count;
+        tspin_mini_count += fstat.tspin_mini_count;
+        finesse += fstat.finesse_faults;
         frames_elapsed += 1;
     }
 
+    // Return the game time elapsed in seconds
+    double time_elapsed() const
+    {
+        return double(frames_elapsed) / tickrate;
+    }
+
     // Dump the current statistics object to the specified stream
     void dump(FILE *fd = stdout) const
     {
         std::printf("Blocks Placed: %d\n", blocks_placed);
         std::printf("Lines Cleared: %d\n", lines_cleared);
+        std::printf("T-Spins: %d (%d mini)\n", tspin_count, tspin_mini_count);
+        std::printf("Finesse Faults: %d\n", finesse);
 
-        const float time_elapsed = frames_elapsed * 16.66f / 1000;
-        std::printf("Time: %.4fs\n", time_elapsed);
-        std::printf("PPS: %.4fs\n", blocks_placed / time_elapsed);
+        std::printf("Time: %.4fs\n", time_elapsed());
+        std::printf("PPS: %.4fs\n", blocks_placed / time_elapsed());
     }
 
-    // The current finesse this game
+    // Total inputs used over the minimum required this game
     int finesse;
 
     // How many blocks have been placed this frame
@@ -83,11 +103,17 @@ struct statistics
     // Frames elapsed over entire game
     int frames_elapsed;
 
+    // Number of frames (engine ticks) per second
+    int tickrate;
+
     // Total lines cleared this game
     int lines_cleared;
 
     // Total t-spins this game
     int tspin_count;
+
+    // Total t-spin minis this game
+    int tspin_mini_count;
 };
 
 } // namespace mpe
@@ -0,0 +1,191 @@
+///
+// trace.hpp
+//
+// Scoped timing probes which can be dumped as Chrome trace-event JSON (open
+// the output in chrome://tracing or https://ui.perfetto.dev).
+//
+//      void engine::update()
+//      {
+//          MPE_TRACE_SCOPE("engine::update");
+//          ...
+//      }
+//
+// Probes are only compiled in when MPE_TRACE is defined. Otherwise the macros
+// expand to nothing and cost nothing.
+//
+// Each thread records into its own fixed-size ring buffer, so recording
+// never takes a lock or allocates once a thread has recorded its first
+// event. Only the newest events are kept when a ring fills. A ring is
+// registered (under a lock) the first time a thread records, and outlives
+// the thread so that it can still be dumped at exit.
+
+#pragma once
+
+#ifdef MPE_TRACE
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mpe::trace {
+
+// Number of events kept by each thread
+static constexpr size_t c_ring_size = 1 << 16;
+
+// A completed scope
+struct event
+{
+    const char *name;
+    int64_t begin;
+    int64_t end;
+};
+
+// The events recorded by a single thread
+struct ring
+{
+    ring(const int tid_) : tid(tid_), name(nullptr), head(0) {}
+
+    // Record an event. Must only be called from the owning thread.
+    void push(const event &e)
+    {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        events[h % c_ring_size] = e;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Identifier of the owning thread in the output
+    const int tid;
+
+    // Name of the owning thread, if one was given
+    const char *name;
+
+    // Number of events ever recorded
+    std::atomic<uint64_t> head;
+
+    // Event storage
+    std::array<event, c_ring_size> events;
+};
+
+// The rings of every thread which has recorded an event
+struct registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ring>> rings;
+};
+
+inline registry& global_registry()
+{
+    static registry instance;
+    return instance;
+}
+
+// Return the ring of the calling thread, registering it on first use.
+inline ring& thread_ring()
+{
+    thread_local ring *local = nullptr;
+
+    if (!local) {
+        registry &r = global_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.rings.push_back(std::make_unique<ring>(r.rings.size() + 1));
+        local = r.rings.back().get();
+    }
+
+    return *local;
+}
+
+// Return the current time in nanoseconds.
+inline int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Name the calling thread in the output. The name must outlive the dump.
+inline void name_thread(const char *name)
+{
+    thread_ring().name = name;
+}
+
+// Records the time between its construction and destruction.
+class scope
+{
+  public:
+    scope(const char *name) : name(name), begin(now()) {}
+
+    ~scope()
+    {
+        thread_ring().push({name, begin, now()});
+    }
+
+  private:
+    const char *name;
+    const int64_t begin;
+};
+
+// Write every recorded event to the given file as Chrome trace-event JSON.
+// This should be called once the traced threads have stopped recording.
+inline bool dump(const char *path)
+{
+    FILE *fd = std::fopen(path, "w");
+    if (!fd)
+        return false;
+
+    registry &r = global_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::fprintf(fd, "{\"traceEvents\":[\n");
+    bool first = true;
+
+    for (const auto &ring : r.rings) {
+        if (ring->name) {
+            std::fprintf(fd, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", ring->tid, ring->name);
+            first = false;
+        }
+
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > c_ring_size ? head - c_ring_size : 0;
+
+        for (uint64_t i = begin; i < head; ++i) {
+            const event &e = ring->events[i % c_ring_size];
+            std::fprintf(fd, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", e.name, ring->tid,
+                    e.begin / 1000.0, (e.end - e.begin) / 1000.0);
+            first = false;
+        }
+    }
+
+    std::fprintf(fd, "\n]}\n");
+    return std::fclose(fd) == 0;
+}
+
+} // namespace mpe::trace
+
+#define MPE_TRACE_CONCAT_(a, b) a##b
+#define MPE_TRACE_CONCAT(a, b) MPE_TRACE_CONCAT_(a, b)
+
+// Time the rest of the enclosing scope under the given name (a literal).
+#define MPE_TRACE_SCOPE(name) \
+    mpe::trace::scope MPE_TRACE_CONCAT(mpe_trace_scope_, __LINE__)(name)
+
+// Name the calling thread in the trace output.
+#define MPE_TRACE_THREAD(name) mpe::trace::name_thread(name)
+
+// Write the trace to the given path.
+#define MPE_TRACE_DUMP(path) mpe::trace::dump(path)
+
+#else
+
+#define MPE_TRACE_SCOPE(name)
+#define MPE_TRACE_THREAD(name)
+#define MPE_TRACE_DUMP(path)
+
+#endif
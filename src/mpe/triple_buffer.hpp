@@ -0,0 +1,97 @@
+///
+// triple_buffer.hpp
+//
+// Passes the latest value from one producer thread to one consumer thread
+// without either side ever waiting on the other.
+//
+// Three buffers are kept: one owned by the writer, one owned by the reader,
+// and one shared between them. Publishing swaps the writer's buffer with the
+// shared one and marks it fresh. Acquiring swaps the shared buffer with the
+// reader's one if it is fresh. Values which are published while the reader
+// is busy are replaced by newer ones, and the writer is told so that it can
+// carry anything the reader must not miss into the next value.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace mpe {
+
+template <typename T>
+class triple_buffer
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
+
+    triple_buffer() : back(0), front(1), shared(2) {}
+
+    // Return the buffer the writer should fill before calling publish. Must
+    // only be called from the writer thread.
+    T& write_buffer()
+    {
+        return buffers[back];
+    }
+
+    // Make the write buffer available to the reader, replacing any value it
+    // has not yet acquired. Returns true if a value was replaced, in which
+    // case the new write buffer holds that unread value.
+    bool publish()
+    {
+        const int previous =
+            shared.exchange(back | c_fresh, std::memory_order_acq_rel);
+
+        back = previous & c_index;
+        return previous & c_fresh;
+    }
+
+    // Take the most recently published value, returning false if nothing has
+    // been published since the last call. Must only be called from the
+    // reader thread.
+    bool acquire()
+    {
+        if (!(shared.load(std::memory_order_relaxed) & c_fresh))
+            return false;
+
+        front = shared.exchange(front, std::memory_order_acq_rel) & c_index;
+        return true;
+    }
+
+    // Return whether a value has been published which the reader has not yet
+    // acquired.
+    bool fresh() const
+    {
+        return shared.load(std::memory_order_relaxed) & c_fresh;
+    }
+
+    // Return the value last acquired by the reader.
+    const T& read_buffer() const
+    {
+        return buffers[front];
+    }
+
+  private:
+    // The shared index is tagged with whether it holds an unread value
+    static constexpr int c_fresh = 4;
+    static constexpr int c_index = 3;
+
+    ///----------------
+    // Member Variables
+    ///---
+
+    // Value storage
+    std::array<T, 3> buffers;
+
+    // Index of the buffer owned by the writer
+    int back;
+
+    // Index of the buffer owned by the reader
+    int front;
+
+    // Index of the shared buffer, along with the fresh flag
+    alignas(64) std::atomic<int> shared;
+};
+
+} // namespace mpe
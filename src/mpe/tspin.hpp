@@ -0,0 +1,87 @@
+///
+// tspin.hpp
+//
+// Detects T-spins when a T block is locked, using the 3-corner rule:
+//  - The last successful move of the block must have been a rotation.
+//  - At least three of the four cells diagonal to the centre of the T must be
+//    filled. Cells outside the walls or below the floor count as filled.
+//  - The spin is a mini unless both corners on the pointing side of the T are
+//    filled, or the rotation used the final wallkick test.
+//
+// The corners are read from the row bitmasks of the field, so a check costs a
+// few shifts regardless of where the block is.
+
+#pragma once
+
+#include <cstdint>
+
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/utility.hpp"
+
+namespace mpe {
+
+enum spin_type {
+    spin_none,
+    spin_mini,
+    spin_full,
+};
+
+// Corner bits, relative to the origin of a T block. The centre of the T is at
+// (1, -1) so the corners are at (0, 0), (2, 0), (0, -2) and (2, -2).
+static const unsigned c_corner_top_left     = 1;
+static const unsigned c_corner_top_right    = 2;
+static const unsigned c_corner_bottom_left  = 4;
+static const unsigned c_corner_bottom_right = 8;
+
+// The corners on the pointing side of a T block in each rotation
+static const unsigned c_front_corners[4] = {
+    c_corner_top_left | c_corner_top_right,
+    c_corner_top_right | c_corner_bottom_right,
+    c_corner_bottom_left | c_corner_bottom_right,
+    c_corner_top_left | c_corner_bottom_left,
+};
+
+// The wallkick test which always counts as a full T-spin
+static const int c_tspin_kick = 4;
+
+// Return the occupancy of the cells at column x and x + 2 of row y as a
+// two-bit mask. Walls and the floor are filled, rows above the field are not.
+inline unsigned tspin_corner_pair(const field &field, const int x, const int y)
+{
+    if (y < 0)
+        return 3;
+    if (y >= field.height + field.hidden)
+        return 0;
+
+    // Add a wall on either side so that column -1 maps to bit 0
+    const uint32_t row = field.rows[y];
+    const uint32_t walled = (row << 1) | 1 | (1u << (field.width + 1));
+    const uint32_t window = walled >> (x + 1);
+    return (window & 1) | ((window >> 1) & 2);
+}
+
+// Return the type of spin performed by a block about to be locked at its
+// current position. rotated specifies whether the last successful move of the
+// block was a rotation.
+inline spin_type detect_tspin(const field &field, const block &block,
+                              const bool rotated)
+{
+    if (!rotated || block.id != bT - 1)
+        return spin_none;
+
+    const unsigned corners =
+        tspin_corner_pair(field, block.x, block.y) |
+        tspin_corner_pair(field, block.x, block.y - 2) << 2;
+
+    if (popcount(corners) < 3)
+        return spin_none;
+
+    const unsigned front = c_front_corners[block.r];
+    if ((corners & front) == front || block.kick == c_tspin_kick)
+        return spin_full;
+
+    return spin_mini;
+}
+
+} // namespace mpe
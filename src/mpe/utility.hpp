@@ -6,6 +6,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <string>
 #include <type_traits>
 
@@ -25,6 +26,33 @@ constexpr typename std::underlying_type<T>::type enum_cast(T t)
     return static_cast<typename std::underlying_type<T>::type>(t);
 }
 
+// Return the number of set bits in the given value.
+inline int popcount(const uint32_t v)
+{
+    return __builtin_popcount(v);
+}
+
+// Return the index of the lowest set bit in the given (non-zero) value.
+inline int lowest_bit(const uint32_t v)
+{
+    return __builtin_ctz(v);
+}
+
+// Return the index of the highest set bit in the given (non-zero) value.
+inline int highest_bit(const uint32_t v)
+{
+    return 31 - __builtin_clz(v);
+}
+
+// Scramble a 64-bit value (splitmix64 finalizer). Useful for deriving
+// well-distributed hash keys from small integers.
+constexpr uint64_t mix64(uint64_t v)
+{
+    v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ull;
+    v = (v ^ (v >> 27)) * 0x94d049bb133111ebull;
+    return v ^ (v >> 31);
+}
+
 // A macro to calculate at compile-time the directory of the current file
 #define MPE_compile_time_current_dir                              \
 ({                                                                \
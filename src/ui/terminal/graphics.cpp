@@ -1,7 +1,7 @@
 ///
 // graphics.cpp
 //
-// Implementation of a ui based on ncurses.
+// Implementation of a ui drawn with termdraw.
 // Specifies an example ui implementation. This is generic and does not do any
 // special drawing based on the mode. This design needs to be revised and
 // thought about before any implementation.
@@ -10,12 +10,14 @@
 // but this information should be left to the ui to display. If this could be
 // down in a rule-agnostic way that would be ideal.
 
+#include <algorithm>
 #include <tuple>
 #include <utility>
-#include <ncurses.h>
 #include <signal.h>
 
 #include <mpe/engine.hpp>
+#include <mpe/snapshot.hpp>
+#include <mpe/trace.hpp>
 #include <ui/terminal/graphics.hpp>
 #ifndef NO_X11
 #include <ui/terminal/x11_window.hpp>
@@ -23,67 +25,46 @@
 
 graphics *graphics::instance = nullptr;
 
-// Initialize of ncurses colour pallete
-static void initialize_colors(bool reverse_colorscheme = false)
+// Colour of each block in the xterm 256 colour palette, indexed by block
+// colour (block id + 1).
+static const int16_t c_block_colors[8] = {
+    termdraw::c_default_color,
+    51,     // bI: cyan
+    21,     // bT: blue
+    214,    // bL: orange
+    226,    // bJ: yellow
+    46,     // bS: green
+    129,    // bZ: purple
+    196,    // bO: red
+};
+
+// Flag marking a composited cell as part of the ghost
+static constexpr int c_ghost_flag = 8;
+
+graphics::graphics(const bool unicode_) :
+    unicode(unicode_), redraw_all(true), dirty(0), dirty_rows(0),
+    piece_rows(0), resized(false)
 {
-    init_color(bI,    0, 1000, 1000);
-    init_color(bT,    0,    0, 1000);
-    init_color(bL, 1000,  647,    0);
-    init_color(bJ, 1000, 1000,    0);
-    init_color(bS,    0, 1000,    0);
-    init_color(bZ,  667,    0, 1000);
-    init_color(bO, 1000,    0,    0);
-
-    if (!reverse_colorscheme) {
-        init_pair(1, bI, 0);
-        init_pair(2, bT, 0);
-        init_pair(3, bL, 0);
-        init_pair(4, bJ, 0);
-        init_pair(5, bS, 0);
-        init_pair(6, bZ, 0);
-        // TODO: White blocks are not rendered well by lxterminal
-        init_pair(7, bO, 0);
-    }
-    else {
-        init_pair(1, 0, bI);
-        init_pair(2, 0, bT);
-        init_pair(3, 0, bL);
-        init_pair(4, 0, bJ);
-        init_pair(5, 0, bS);
-        init_pair(6, 0, bZ);
-        init_pair(7, 0, bO);
-    }
+    initialize();
 }
 
-graphics::graphics(const bool unicode_) :
-    render_color(false), unicode(unicode_)
+graphics::graphics(const bool unicode_, const std::vector<int> &input_fds,
+                   const int output_fd) :
+    screen(output_fd), unicode(unicode_), redraw_all(true), dirty(0),
+    dirty_rows(0), piece_rows(0), resized(false), input(input_fds)
+{
+    initialize();
+}
+
+void graphics::initialize()
 {
-    // Attempt to replace signal handler action
-    // If we set this before ncurses, this will be called along with the
-    // ncurses signal handler.
-    const struct sigaction new_sigaction = {
-        // sa_sigaction and sa_handler may be a union
-        .sa_handler = static_sigwinch_handler,
-        .sa_flags   = SA_NODEFER
-    };
+    struct sigaction new_sigaction = {};
+    new_sigaction.sa_handler = static_sigwinch_handler;
+    new_sigaction.sa_flags = SA_NODEFER;
 
     sigaction(SIGWINCH, &new_sigaction, nullptr);
     graphics::instance = this;
 
-    initscr();
-    curs_set(false);
-    timeout(false);
-    noecho();           // Required to avoid end-game character dump
-
-    if (has_colors()) {
-        render_color = true;
-        start_color();
-        initialize_colors(unicode ? false : true);
-    }
-
-    // Macro: height and width are modified.
-    getmaxyx(stdscr, height, width);
-
 #ifndef NO_X11
     // Attempt to utilize the X11 input system to avoid requiring root
     // permissions, falling back to the linux/input.h method otherwise.
@@ -94,9 +75,8 @@ graphics::graphics(const bool unicode_) :
 
 graphics::~graphics()
 {
-    // Read all buffered input so it isn't dumped on exit
-    while (getch() != ERR) {}
-    endwin();
+    signal(SIGWINCH, SIG_DFL);
+    graphics::instance = nullptr;
 }
 
 void graphics::static_sigwinch_handler(int signo)
@@ -106,44 +86,45 @@ void graphics::static_sigwinch_handler(int signo)
 
 void graphics::sigwinch_handler(int signo)
 {
-    // This recalculates the internal cols and lines variables
-    endwin();
-    refresh();
-
-    // Macro: height and width are modified.
-    getmaxyx(stdscr, height, width);
-    erase();
+    // The signal may arrive on any thread, so leave the resize to the next
+    // render rather than touching the screen buffers here.
+    resized.store(true, std::memory_order_relaxed);
 }
 
 void graphics::update(mpe::engine &engine)
 {
-    using keycode_map = std::pair<int, mpe::keycode>;
-
-    static const std::array<keycode_map, mpe::keycode_length> keymap = {{
-        { KEY_LEFT  , mpe::keycode::left },
-        { KEY_RIGHT , mpe::keycode::right },
-        { KEY_DOWN  , mpe::keycode::down },
-        { KEY_UP    , mpe::keycode::up },
-        { KEY_SPACE , mpe::keycode::space },
-        { KEY_Z     , mpe::keycode::z },
-        { KEY_X     , mpe::keycode::x },
-        { KEY_Q     , mpe::keycode::q },
-        { KEY_C     , mpe::keycode::c }
-    }};
-
-    input.read_events();
-    for (auto key : keymap) {
-        if (input.is_down(key.first)) {
-            engine.keystate.key_down(key.second);
-        }
-        else
-            engine.keystate.key_up(key.second);
-    }
+    // Events are read and timestamped on the input thread, so this only
+    // needs to hand them over.
+    input.drain(engine);
 }
 
-void graphics::render(const mpe::engine &engine) const
+void graphics::wait(const std::chrono::steady_clock::time_point until)
 {
-    erase();
+    input.wait(until);
+}
+
+void graphics::render(const mpe::snapshot &snapshot)
+{
+    MPE_TRACE_SCOPE("graphics::render");
+
+    if (resized.exchange(false, std::memory_order_relaxed)) {
+        screen.resize();
+        redraw_all = true;
+    }
+
+    // Only the parts which changed since the last drawn snapshot are cleared
+    // and redrawn, unless the whole screen has been invalidated.
+    dirty = snapshot.dirty;
+    dirty_rows = snapshot.dirty_rows;
+
+    if (redraw_all) {
+        screen.erase();
+        dirty = mpe::dirty_all;
+        dirty_rows = ~0ull;
+    }
+
+    const int width = screen.width;
+    const int height = screen.height;
 
     // WHere the upper region of the draw window should be located
     const int iy = (height - 26) / 2;
@@ -171,135 +152,247 @@ void graphics::render(const mpe::engine &engine) const
     // Field only.
     else if (width < field_width + preview_width) {
         const int xoffset = (field_width + preview_width - width) / 2;
-        render_field(xoffset, iy, engine);
+        render_field(xoffset, iy, snapshot);
     }
     // Field, Preview.
     else if (width < field_width + preview_width + hold_width +
             seperator_width) {
         const int xoffset = (field_width + preview_width - width) / 2;
-        render_field(xoffset, iy, engine);
-        render_preview(xoffset + field_width + seperator_width, iy, engine);
+        render_field(xoffset, iy, snapshot);
+        render_preview(xoffset + field_width + seperator_width, iy, snapshot);
     }
     // Field, Preview, Hold
     else if (width < field_width + preview_width + hold_width +
             statistics_width + 2 * seperator_width) {
         const int xoffset = (field_width + preview_width + hold_width
                 - width) / 2;
-        render_hold(xoffset, iy, engine);
-        render_field(xoffset + hold_width + seperator_width, iy, engine);
+        render_hold(xoffset, iy, snapshot);
+        render_field(xoffset + hold_width + seperator_width, iy, snapshot);
         render_preview(xoffset + seperator_width + hold_width +
-                seperator_width + field_width, iy, engine);
+                seperator_width + field_width, iy, snapshot);
     }
     // Field, Preview, Hold, Statistics
     else {
         const int xoffset = (width - field_width - preview_width - hold_width -
                 statistics_width) / 2;
-        render_hold(xoffset, iy, engine);
-        render_field(xoffset + hold_width + seperator_width, iy, engine);
+        render_hold(xoffset, iy, snapshot);
+        render_field(xoffset + hold_width + seperator_width, iy, snapshot);
         render_preview(xoffset + hold_width + seperator_width +
-                field_width + seperator_width, iy, engine);
+                field_width + seperator_width, iy, snapshot);
         render_statistics(xoffset + hold_width + seperator_width +
                 field_width + seperator_width + preview_width +
-                seperator_width, iy, engine);
+                seperator_width, iy, snapshot);
     }
 
-    refresh();
+    redraw_all = false;
+    screen.update();
+
+    // The frame has been handed to the terminal, which is as close to the
+    // display as we can measure
+    if (snapshot.input_time != mpe::c_no_input) {
+        const int64_t now = std::chrono::duration_cast<
+            std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                      .time_since_epoch()).count();
+        photon_latency.record(now - snapshot.input_time * 1000);
+    }
+}
+
+const mpe::histogram& graphics::input_to_photon() const
+{
+    return photon_latency;
+}
+
+termdraw::style graphics::block_style(const int color) const
+{
+    // Ascii blocks are drawn as coloured spaces
+    termdraw::style style;
+    if (unicode)
+        style.fg = c_block_colors[color];
+    else
+        style.bg = c_block_colors[color];
+
+    return style;
+}
+
+// Return the field rows covered by a block as a dirty row mask.
+static uint64_t block_rows(const mpe::block &block)
+{
+    uint64_t rows = 0;
+    for (const auto &p : block.data) {
+        if (block.y + p.y >= 0)
+            rows |= mpe::field::row_bit(block.y + p.y);
+    }
+
+    return rows;
+}
+
+void graphics::composite_field(const mpe::snapshot &snapshot)
+{
+    const mpe::field &field = snapshot.field;
+    const int cells = field.width * field.height;
+
+    composite.resize(cells);
+    std::copy_n(field.data.begin(), cells, composite.begin());
+
+    // The ghost is stamped before the block so the block is drawn over it.
+    // Neither is drawn over a filled cell.
+    const mpe::block *blocks[2] = {&snapshot.ghost, &snapshot.block};
+    const int flags[2] = {c_ghost_flag, 0};
+
+    for (int i = 0; i < 2; ++i) {
+        const mpe::block &block = *blocks[i];
+
+        for (const auto &p : block.data) {
+            const int x = block.x + p.x;
+            const int y = block.y + p.y;
+
+            if (x < 0 || x >= field.width || y < 0 || y >= field.height)
+                continue;
+
+            int &cell = composite[y * field.width + x];
+            if (!cell || (cell & c_ghost_flag))
+                cell = (block.id + 1) | flags[i];
+        }
+    }
 }
 
 void graphics::render_field(const int ix, const int iy,
-        const mpe::engine &engine) const
+        const mpe::snapshot &snapshot)
 {
-    for (int y = 0; y < engine.field.height; ++y) {
-        const int ya = iy + engine.field.height - y;
-        attron(unicode ? A_NORMAL : A_REVERSE);
-        mvaddstr(ya, ix, unicode ? "\u2502" : " ");
-        attroff(unicode ? A_NORMAL : A_REVERSE);
-
-        for (int x = 0; x < engine.field.width; ++x) {
-            const int xa = 1 + ix + 2 * x;
-
-            if (engine.field.at(x, y)) {
-                attron(COLOR_PAIR(engine.field.at(x, y)));
-                mvaddstr(ya, xa, unicode ? "\u25a0 " : "  ");
-                attroff(COLOR_PAIR(engine.field.at(x, y)));
-            } else if (engine.block.at(x, y)) {
-                attron(COLOR_PAIR(engine.block.id + 1));
-                mvaddstr(ya, xa, unicode ? "\u25a0 " : "  ");
-                attroff(COLOR_PAIR(engine.block.id + 1));
-            }
-            else if (engine.ghost.at(x, y)) {
-                attron(COLOR_PAIR(engine.ghost.id + 1));
-                mvaddstr(ya, xa, unicode ? "\u25a1 " : "  ");
-                attroff(COLOR_PAIR(engine.ghost.id + 1));
+    termdraw::style border;
+    border.attr = unicode ? 0 : termdraw::c_attr_reverse;
+
+    const int width = snapshot.field.width;
+    const int height = snapshot.field.height;
+
+    // Rows covered by the pieces now and when last drawn must be redrawn if
+    // either piece has moved.
+    uint64_t rows = dirty_rows;
+    const uint64_t pieces = block_rows(snapshot.block) |
+                            block_rows(snapshot.ghost);
+    if (dirty & (mpe::dirty_block | mpe::dirty_ghost))
+        rows |= pieces | piece_rows;
+    piece_rows = pieces;
+
+    if (!rows)
+        return;
+
+    composite_field(snapshot);
+
+    for (int y = 0; y < height; ++y) {
+        if (!(rows & mpe::field::row_bit(y)))
+            continue;
+
+        const int ya = iy + height - y;
+        screen.set_style(border);
+        screen.mvputs(ix, ya, unicode ? "\u2502" : " ");
+        screen.clear(ix + 1, ya, 2 * width, 1);
+
+        // Cells are written left to right, so the style only needs to be
+        // changed where a run of equal cells starts.
+        const int *row = &composite[y * width];
+        for (int x = 0; x < width; ++x) {
+            const int cell = row[x];
+
+            if (!cell) {
+                screen.move(ix + 3 + 2 * x, ya);
+                continue;
             }
+
+            if (x == 0 || cell != row[x - 1])
+                screen.set_style(block_style(cell & ~c_ghost_flag));
+
+            if (cell & c_ghost_flag)
+                screen.puts(unicode ? "\u25a1 " : "  ");
+            else
+                screen.puts(unicode ? "\u25a0 " : "  ");
         }
 
-        attron(unicode ? A_NORMAL : A_REVERSE);
-        mvaddstr(ya, 1 + ix + 2 * engine.field.width, unicode ? "\u2502" : " ");
-        attroff(unicode ? A_NORMAL : A_REVERSE);
+        screen.set_style(border);
+        screen.mvputs(1 + ix + 2 * width, ya, unicode ? "\u2502" : " ");
     }
 
-    attron(unicode ? A_NORMAL : A_REVERSE);
-    mvaddstr(iy + engine.field.height + 1, ix, unicode ? "\u2514" : " ");
-    attroff(unicode ? A_NORMAL : A_REVERSE);
+    if (redraw_all) {
+        screen.mvputs(ix, iy + height + 1, unicode ? "\u2514" : " ");
+
+        screen.reset_style();
+        for (int x = 0; x < width; ++x)
+            screen.puts(unicode ? "\u2500\u2500" : "__");
 
-    for (int x = 0; x < engine.field.width; ++x)
-        addstr(unicode ? "\u2500\u2500" : "__");
+        screen.set_style(border);
+        screen.puts(unicode ? "\u2518" : " ");
+    }
 
-    attron(unicode ? A_NORMAL : A_REVERSE);
-    addstr(unicode ? "\u2518" : " ");
-    attroff(unicode ? A_NORMAL : A_REVERSE);
+    screen.reset_style();
 }
 
 
 void graphics::render_block(const int x, const int y,
-        const mpe::block &block) const
+        const mpe::block &block)
 {
-    attron(COLOR_PAIR(block.id + 1));
+    screen.set_style(block_style(block.id + 1));
     for (int i = 0; i < block.data.size(); ++i) {
         const int xa = x + 2 * block.data[i].x;
         const int ya = y - block.data[i].y;
-        mvaddstr(ya, xa, unicode ? "\u25a0 " : "  ");
+        screen.mvputs(xa, ya, unicode ? "\u25a0 " : "  ");
     }
-    attroff(COLOR_PAIR(block.id + 1));
+    screen.reset_style();
 }
 
 void graphics::render_preview(const int ix, const int iy,
-        const mpe::engine &engine) const
+        const mpe::snapshot &snapshot)
 {
-    if (engine.randomizer->preview_count() == 0)
+    if (!(dirty & mpe::dirty_preview))
         return;
 
-    auto pieces = engine.randomizer->preview_pieces();
-
-    for (int i = 0; i < std::min(engine.randomizer->preview_count(), 4); ++i) {
-        mpe::block preview(pieces[i]);
+    screen.clear(ix, iy, 8, 4 * 5);
+    for (int i = 0; i < std::min(snapshot.preview_count, 4); ++i) {
+        mpe::block preview(snapshot.preview[i]);
         render_block(ix, iy + i * 5, preview);
     }
 }
 
 void graphics::render_hold(const int ix, const int iy,
-        const mpe::engine &engine) const
+        const mpe::snapshot &snapshot)
 {
-    if (!engine.hold)
+    if (!(dirty & mpe::dirty_hold))
         return;
 
-    mpe::block hold(engine.hold.value().id);
+    screen.clear(ix, iy, 8, 2);
+    if (!snapshot.has_hold)
+        return;
+
+    mpe::block hold(snapshot.hold);
     render_block(ix, iy, hold);
 }
 
 void graphics::render_statistics(const int ix, const int iy,
-        const mpe::engine &engine) const
+        const mpe::snapshot &snapshot)
 {
     const int ya = iy + 4;
+    const int width = 24;
 
-    mvprintw(ya + 0, ix, "Blocks Placed: %d", engine.statistics.blocks_placed);
+    if (dirty & mpe::dirty_statistics) {
+        screen.clear(ix, ya + 0, width, 1);
+        screen.mvprintf(ix, ya + 0, "Blocks Placed: %d",
+                snapshot.statistics.blocks_placed);
 
-    mvprintw(ya + 2, ix, "Lines Cleared: %d", engine.statistics.lines_cleared);
+        screen.clear(ix, ya + 2, width, 1);
+        screen.mvprintf(ix, ya + 2, "Lines Cleared: %d",
+                snapshot.statistics.lines_cleared);
+
+        screen.clear(ix, ya + 8, width, 1);
+        screen.mvprintf(ix, ya + 8, "Finesse: %d",
+                snapshot.statistics.finesse);
+    }
 
-    const float time_elapsed = engine.statistics.frames_elapsed * 16.66f / 1000;
-    mvprintw(ya + 4, ix, "Time: %.4fs", time_elapsed);
+    // The clock advances with every tick, so it is always redrawn. Only the
+    // characters which actually change are sent.
+    const float time_elapsed = snapshot.statistics.time_elapsed();
+    screen.clear(ix, ya + 4, width, 1);
+    screen.mvprintf(ix, ya + 4, "Time: %.4fs", time_elapsed);
 
-    const float pps = engine.statistics.blocks_placed / time_elapsed;
-    mvprintw(ya + 6, ix, "PPS: %.4fs", pps);
+    const float pps = snapshot.statistics.blocks_placed / time_elapsed;
+    screen.clear(ix, ya + 6, width, 1);
+    screen.mvprintf(ix, ya + 6, "PPS: %.4fs", pps);
 }
@@ -11,8 +11,16 @@
 
 #pragma once
 
-#include <ui/terminal/linux_input.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <ui/terminal/input_thread.hpp>
+#include <ui/terminal/termdraw.hpp>
 #include <mpe/engine.hpp>
+#include <mpe/histogram.hpp>
+#include <mpe/snapshot.hpp>
 
 // This class can only have one available instance at any one time active.
 // See the member 'instance' for a small discussion on why.
@@ -22,6 +30,11 @@ class graphics
     // Initialize a graphical context.
     graphics(bool unicode=true);
 
+    // Initialize a graphical context which reads input from the given file
+    // descriptors (see linux_input) and draws to output_fd. This allows the
+    // ui to be run headless.
+    graphics(bool unicode, const std::vector<int> &input_fds, int output_fd);
+
     // Destory a graphical context.
     ~graphics();
 
@@ -30,10 +43,22 @@ class graphics
     // events, but this could be improved in the future.
     void update(mpe::engine &engine);
 
-    // Render the state of the engine onto the screen.
-    void render(const mpe::engine &engine) const;
+    // Sleep until the given time, or until there are events for update.
+    void wait(std::chrono::steady_clock::time_point until);
+
+    // Render a snapshot of the engine onto the screen. This may be called
+    // from a different thread to update, but only ever from one thread.
+    void render(const mpe::snapshot &snapshot);
+
+    // Return the distribution of times from a key event to the end of
+    // writing the first frame to show its effect, in nanoseconds. Must only
+    // be read from the rendering thread, or once rendering has stopped.
+    const mpe::histogram& input_to_photon() const;
 
   private:
+    // Install the resize handler and make this the current instance.
+    void initialize();
+
     // Handle SIGWINCH calls on the current class.
     void sigwinch_handler(int signal);
 
@@ -41,35 +66,58 @@ class graphics
     // method for a signal handler.
     static void static_sigwinch_handler(int signal);
 
+    // Return the style used to draw a cell of the specified block colour.
+    termdraw::style block_style(const int color) const;
+
+    // Fill composite with the visible field, ghost and current block.
+    void composite_field(const mpe::snapshot &snapshot);
+
     // Render the specified field state at the specified initial x and y position.
-    void render_field(const int ix, const int iy, const mpe::engine &engine) const;
+    void render_field(const int ix, const int iy, const mpe::snapshot &snapshot);
 
     // Render the specified block at the x and y position.
-    void render_block(const int ix, const int iy, const mpe::block &block) const;
+    void render_block(const int ix, const int iy, const mpe::block &block);
 
     // Render the specified statistics at the x and y position.
-    void render_statistics(const int ix, const int iy, const mpe::engine &engine) const;
+    void render_statistics(const int ix, const int iy, const mpe::snapshot &snapshot);
 
     // Render the specified preview piece at the x and y position.
-    void render_preview(const int ix, const int iy, const mpe::engine &engine) const;
+    void render_preview(const int ix, const int iy, const mpe::snapshot &snapshot);
 
     // Render the specified hold piece at the x and y position.
-    void render_hold(const int ix, const int iy, const mpe::engine &engine) const;
+    void render_hold(const int ix, const int iy, const mpe::snapshot &snapshot);
 
-    // The current height of the terminal
-    int height;
+    // The terminal being drawn to
+    termdraw::window screen;
 
-    // The current width of the terminal
-    int width;
-
-    // Should the render phase attempt to draw with colour
-    bool render_color;
+    // Block colour of each visible field cell, with the ghost flagged. This
+    // is rebuilt each frame but keeps its storage.
+    std::vector<int> composite;
 
     // Should we render unicode glyphs, or ascii?
     bool unicode;
 
-    // The current device we are using to read events.
-    linux_input input;
+    // Must the whole screen be redrawn on the next render?
+    bool redraw_all;
+
+    // Parts of the snapshot being rendered which must be redrawn, as
+    // mpe::dirty_flag bits
+    unsigned dirty;
+
+    // Field rows of the snapshot being rendered which must be redrawn
+    uint64_t dirty_rows;
+
+    // Field rows covered by the block and ghost when last drawn
+    uint64_t piece_rows;
+
+    // Has the terminal been resized since the last render?
+    std::atomic<bool> resized;
+
+    // Input to photon latency
+    mpe::histogram photon_latency;
+
+    // The thread reading events from the input device.
+    input_thread input;
 
 #ifndef NO_X11
     // The X11 window-id of the terminal which is running this program.
@@ -82,9 +130,8 @@ class graphics
     // This specifies the current instance. This in effect limits the number of
     // available instances of this class to one.
     //
-    // This likely isn't as big a problem as one would expect, since ncurses
-    // itself is used in a way which does not allow multiple windows to be run
-    // at one.
+    // This likely isn't as big a problem as one would expect, since the
+    // terminal itself can only be drawn to by one window at once.
     //
     // This is an effect of not being able to bind extra arguments onto the
     // c style signal handlers.
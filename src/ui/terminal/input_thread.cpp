@@ -0,0 +1,93 @@
+///
+// input_thread.cpp
+//
+// Implementation of the dedicated input reading thread.
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <mpe/trace.hpp>
+#include <ui/terminal/input_thread.hpp>
+
+// Mapping of device keycodes to engine keycodes
+using keycode_map = std::pair<int, mpe::keycode>;
+
+static const std::array<keycode_map, mpe::keycode_length> c_keymap = {{
+    { KEY_LEFT  , mpe::keycode::left },
+    { KEY_RIGHT , mpe::keycode::right },
+    { KEY_DOWN  , mpe::keycode::down },
+    { KEY_UP    , mpe::keycode::up },
+    { KEY_SPACE , mpe::keycode::space },
+    { KEY_Z     , mpe::keycode::z },
+    { KEY_X     , mpe::keycode::x },
+    { KEY_Q     , mpe::keycode::q },
+    { KEY_C     , mpe::keycode::c }
+}};
+
+input_thread::input_thread() :
+    running(true)
+{
+    thread = std::thread(&input_thread::run, this);
+}
+
+input_thread::input_thread(const std::vector<int> &fds) :
+    input(fds), running(true)
+{
+    thread = std::thread(&input_thread::run, this);
+}
+
+input_thread::~input_thread()
+{
+    running.store(false, std::memory_order_relaxed);
+    input.interrupt();
+    thread.join();
+}
+
+void input_thread::drain(mpe::engine &engine)
+{
+    mpe::key_event event;
+    while (queue.pop(event))
+        engine.push_event(event);
+}
+
+void input_thread::wait(const std::chrono::steady_clock::time_point until)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait_until(lock, until, [this] { return !queue.empty(); });
+}
+
+void input_thread::run()
+{
+    MPE_TRACE_THREAD("input");
+
+    while (running.load(std::memory_order_relaxed)) {
+        // Sleep until the device has events or we are woken to stop
+        input.read_events(-1);
+
+        for (const auto &event : input.events()) {
+            for (auto key : c_keymap) {
+                if (event.code != key.first)
+                    continue;
+
+                const int64_t time = int64_t(event.time.tv_sec) * 1000000 +
+                                     event.time.tv_usec;
+                const mpe::key_event e = {time, key.second, event.value == 1};
+
+                // Never drop an event since a lost release would leave a key
+                // held. The queue only fills if the game thread stalls.
+                while (!queue.push(e) &&
+                        running.load(std::memory_order_relaxed)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Notifying under the lock means a waiter cannot miss the events
+        // between checking the queue and going to sleep.
+        if (!input.events().empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.notify_one();
+        }
+    }
+}
@@ -0,0 +1,66 @@
+///
+// input_thread.hpp
+//
+// Reads keyboard events on a dedicated thread. The thread sleeps on the input
+// device until events arrive, converts them into engine key events as soon as
+// they are read, and passes them to the game thread through a lock-free
+// single-producer/single-consumer queue. The game thread only has to drain
+// the queue, so no input syscalls are made during a tick.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <mpe/engine.hpp>
+#include <mpe/keystate.hpp>
+#include <mpe/spsc_queue.hpp>
+#include <ui/terminal/linux_input.hpp>
+
+// Number of events which can be waiting for the game thread
+static constexpr size_t c_input_queue_size = 1024;
+
+class input_thread
+{
+  public:
+    // Open the input device and start reading events.
+    input_thread();
+
+    // Start reading events from the given open file descriptors, taking
+    // ownership of them. See linux_input.
+    explicit input_thread(const std::vector<int> &fds);
+
+    // Stop reading events and wait for the thread to finish.
+    ~input_thread();
+
+    // Queue all events read since the last call into the engine. Must only be
+    // called from a single thread.
+    void drain(mpe::engine &engine);
+
+    // Sleep until the given time, or until events are waiting to be drained.
+    void wait(std::chrono::steady_clock::time_point until);
+
+  private:
+    // Read events until stopped.
+    void run();
+
+    // The device we are using to read events.
+    linux_input input;
+
+    // Events waiting for the game thread
+    mpe::spsc_queue<mpe::key_event, c_input_queue_size> queue;
+
+    // Signalled when events are added to the queue
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    // Is the reader still running?
+    std::atomic<bool> running;
+
+    // The reading thread
+    std::thread thread;
+};
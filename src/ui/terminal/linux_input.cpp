@@ -4,115 +4,345 @@
 // Implementation file for interfacing with the linux/input.h header. This is
 // a thin abstraction over this device.
 //
+// Every event device under /dev/input which reports the keys we use is
+// treated as a keyboard, so built-in and USB keyboards work alike and can be
+// used at the same time. Devices are opened non-blocking and waited on with
+// epoll.
+//
 // A current problem is the inability to filter events based on which windows
 // are in focus. This can be done using X11 (and likely will soon), but I'm not
 // 100% on the plan for when not running an x-server, but using for example a
 // screen multiplexer like tmux/screen.
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <mpe/trace.hpp>
 #include <ui/terminal/linux_input.hpp>
 
-// TODO: Determine appropriate device procedurally
-static constexpr char input_device_name[] =
-    "/dev/input/by-path/platform-i8042-serio-0-event-kbd";
+// Directory scanned for event devices
+static constexpr char input_device_dir[] = "/dev/input";
+
+// Maximum number of events taken from a device by a single read
+static constexpr int c_read_batch = 64;
+
+// Maximum number of ready devices handled by a single wait
+static constexpr int c_max_ready = 16;
+
+// Return the value of the given clock in microseconds.
+static int64_t clock_us(const clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return int64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// Return the offset which converts a realtime clock value in microseconds to
+// the monotonic clock. This is only exact until the realtime clock is next
+// stepped, but a stepped clock cannot be recovered from the stamps anyway.
+static int64_t realtime_offset()
+{
+    return clock_us(CLOCK_MONOTONIC) - clock_us(CLOCK_REALTIME);
+}
+
+// Return whether bit n is set in the given capability bitmask.
+static bool test_bit(const unsigned char *bits, const int n)
+{
+    return bits[n / 8] & (1 << (n % 8));
+}
+
+// Return whether the device reports the keys required to play.
+static bool is_keyboard(const int fd)
+{
+    unsigned char types[EV_MAX / 8 + 1] = {};
+    unsigned char keys[KEY_MAX / 8 + 1] = {};
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(types)), types) == -1 ||
+            !test_bit(types, EV_KEY)) {
+        return false;
+    }
+
+    if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) == -1)
+        return false;
+
+    return test_bit(keys, KEY_SPACE) && test_bit(keys, KEY_Z) &&
+           test_bit(keys, KEY_LEFT);
+}
 
 linux_input::linux_input()
 {
-    input_device_fd = open(input_device_name, O_RDONLY);
+    std::memset(keymap, 0, sizeof(keymap));
+    create_wait_set();
+
+    DIR *dir = opendir(input_device_dir);
+    if (!dir) {
+        std::perror("Error opening input device directory");
+        std::exit(1);
+    }
+
+    std::vector<std::string> paths;
+    while (const struct dirent *entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, "event", 5) != 0)
+            continue;
+
+        paths.push_back(std::string(input_device_dir) + "/" + entry->d_name);
+    }
+    closedir(dir);
+
+    // Open devices in a consistent order
+    std::sort(paths.begin(), paths.end());
+
+    bool permission_denied = false;
+    for (const auto &path : paths) {
+        const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+        if (fd == -1) {
+            permission_denied |= errno == EACCES;
+            continue;
+        }
+
+        if (!is_keyboard(fd)) {
+            close(fd);
+            continue;
+        }
+
+        // Timestamp events with the same clock as std::chrono::steady_clock
+        // so that they can be compared with engine tick times. Kernels which
+        // cannot switch clocks keep stamping with the realtime clock, so those
+        // events are shifted by the offset between the clocks instead.
+        int clock = CLOCK_MONOTONIC;
+        if (ioctl(fd, EVIOCSCLOCKID, &clock) == -1) {
+            std::fprintf(stderr, "Cannot use the monotonic clock for %s (%s), "
+                    "converting realtime event times\n", path.c_str(),
+                    std::strerror(errno));
+            add_device(fd, realtime_offset());
+            continue;
+        }
+
+        add_device(fd);
+    }
 
     // Handle the permission case seperately since this is quite common.
-    if (input_device_fd == -1) {
-        if (errno == EACCES) {
+    if (device_fds.empty()) {
+        if (permission_denied) {
             std::fprintf(stderr,
-                    "Insufficient permissions to open device file: %s\n"
+                    "Insufficient permissions to open devices in: %s\n"
                     "\tRoot permissions are required\n",
-                    input_device_name);
+                    input_device_dir);
         }
         else {
-            std::perror("Error opening input device");
+            std::fprintf(stderr, "No keyboard found in: %s\n",
+                    input_device_dir);
         }
 
         std::exit(1);
     }
+}
 
+linux_input::linux_input(const std::vector<int> &fds)
+{
     std::memset(keymap, 0, sizeof(keymap));
+    create_wait_set();
+
+    for (const int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        add_device(fd);
+    }
 }
 
 linux_input::~linux_input()
 {
-    const int status = close(input_device_fd);
+    while (!device_fds.empty())
+        remove_device(device_fds.back());
 
-    if (status == -1) {
-        std::perror("Error closing input device");
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+void linux_input::create_wait_set()
+{
+    // Waiting is done on an epoll set holding the devices and an eventfd
+    // which can be signalled to wake a waiting reader.
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd == -1 || wake_fd == -1) {
+        std::perror("Error creating input wait set");
+        std::exit(1);
+    }
+
+    struct epoll_event wake_event = {};
+    wake_event.events = EPOLLIN;
+    wake_event.data.fd = wake_fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_event) == -1) {
+        std::perror("Error creating input wait set");
         std::exit(1);
     }
 }
 
-int linux_input::read_events()
+void linux_input::add_device(const int fd, const int64_t offset)
 {
-    struct input_event event;
-    int bytes_read;
+    struct epoll_event device_event = {};
+    device_event.events = EPOLLIN;
+    device_event.data.fd = fd;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &device_event) == -1) {
+        std::perror("Error adding input device");
+        std::exit(1);
+    }
+
+    device_fds.push_back(fd);
+    clock_offsets.push_back(offset);
+}
+
+void linux_input::remove_device(const int fd)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    const auto it = std::find(device_fds.begin(), device_fds.end(), fd);
+    clock_offsets.erase(clock_offsets.begin() + (it - device_fds.begin()));
+    device_fds.erase(it);
+
+    if (close(fd) == -1)
+        std::perror("Error closing input device");
+}
+
+int linux_input::read_events(const int timeout)
+{
+    struct input_event batch[c_read_batch];
+    struct epoll_event ready[c_max_ready];
     int events_read = 0;
 
-    /* Empty all current events then return */
-    while (is_event_pending()) {
-        bytes_read = read(input_device_fd, &event, sizeof(event));
+    key_events.clear();
+
+    const int count = epoll_wait(epoll_fd, ready, c_max_ready, timeout);
+    if (count == -1) {
+        if (errno == EINTR)
+            return 0;
+
+        std::perror("Error waiting for input devices");
+        std::exit(1);
+    }
+
+    // Only the reading is timed, not the wait for events
+    MPE_TRACE_SCOPE("linux_input::read_events");
+
+    for (int i = 0; i < count; ++i) {
+        const int fd = ready[i].data.fd;
+
+        if (fd == wake_fd) {
+            uint64_t value;
+            while (read(wake_fd, &value, sizeof(value)) > 0) {}
+            continue;
+        }
+
+        // Take everything pending with a single read. Anything beyond a full
+        // batch remains readable and is picked up by the next call.
+        const ssize_t bytes_read = read(fd, batch, sizeof(batch));
 
         if (bytes_read == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                continue;
+
+            // The device has been unplugged
+            if (errno == ENODEV) {
+                remove_device(fd);
+                continue;
+            }
+
             std::perror("Error reading from input device");
             std::exit(1);
         }
-        else if (bytes_read < (int) sizeof(event)) {
-            // This can occur if interrupted by a signal. For now, just stop
-            // reading events this loop.
-            // TODO: Determine best course of action to take.
-            break;
+        else if (bytes_read == 0) {
+            // End of file, the device has gone away
+            remove_device(fd);
+            continue;
         }
 
-        // Discard non-input events or ones that are out of range
-        if (event.type != EV_KEY || event.value > 256)
-            continue;
+        // The device only returns whole events
+        const int n = bytes_read / sizeof(struct input_event);
 
-        switch (event.value) {
-          // Key release
-          case 0:
-            events_read += 1;
-            keymap[event.code] = false;
-            break;
-          // Key press
-          case 1:
-            events_read += 1;
-            keymap[event.code] = true;
-            break;
-          // Key autorepeat
-          case 2:
-          default:
-            break;
+        const int64_t offset = clock_offsets[std::find(device_fds.begin(),
+                device_fds.end(), fd) - device_fds.begin()];
+
+        for (int j = 0; j < n; ++j) {
+            struct input_event &event = batch[j];
+
+            // Discard non-input events or ones that are out of range
+            if (event.type != EV_KEY || event.code >= 256)
+                continue;
+
+            if (offset) {
+                const int64_t time = int64_t(event.time.tv_sec) * 1000000 +
+                                     event.time.tv_usec + offset;
+                event.time.tv_sec = time / 1000000;
+                event.time.tv_usec = time % 1000000;
+            }
+
+            switch (event.value) {
+              // Key release
+              case 0:
+                events_read += 1;
+                keymap[event.code] = false;
+                key_events.push_back(event);
+                break;
+              // Key press
+              case 1:
+                events_read += 1;
+                keymap[event.code] = true;
+                key_events.push_back(event);
+                break;
+              // Key autorepeat
+              case 2:
+              default:
+                break;
+            }
         }
     }
 
+    // Devices are read independently, so merge their events by time
+    std::stable_sort(key_events.begin(), key_events.end(),
+        [](const struct input_event &a, const struct input_event &b) {
+            return a.time.tv_sec < b.time.tv_sec ||
+                   (a.time.tv_sec == b.time.tv_sec &&
+                    a.time.tv_usec < b.time.tv_usec);
+        });
+
     return events_read;
 }
 
+void linux_input::interrupt()
+{
+    const uint64_t value = 1;
+    if (write(wake_fd, &value, sizeof(value)) == -1)
+        std::perror("Error waking input reader");
+}
+
+const std::vector<struct input_event>& linux_input::events() const
+{
+    return key_events;
+}
+
 bool linux_input::is_down(const int keycode) const
 {
     return keymap[keycode];
 }
 
-bool linux_input::is_event_pending() const
+int linux_input::device_count() const
 {
-    struct timeval tv = {0, 0};
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(input_device_fd, &fds);
-    select(FD_SETSIZE, &fds, nullptr, nullptr, &tv);
-    return FD_ISSET(input_device_fd, &fds);
+    return device_fds.size();
 }
@@ -7,33 +7,75 @@
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 // File inclusions will usually require the enumeration definitions.
 #include <linux/input.h>
 
 class linux_input
 {
   public:
-    // Initialize the input state by reading the reqired device file.
-    // If we could not open the device, throw an exception.
+    // Initialize the input state by opening every keyboard found under
+    // /dev/input. If no keyboard could be opened, exit with an error.
     linux_input();
 
+    // Initialize the input state using the given open file descriptors as
+    // devices, taking ownership of them. Anything producing input_event
+    // records can be used, such as a pipe standing in for a device in tests.
+    // Their events must be stamped with the monotonic clock.
+    explicit linux_input(const std::vector<int> &fds);
+
     // Close any open file descriptors;
     ~linux_input();
 
-    // Read events into the input buffer, returning the number of events
-    // that were read. Return -1 on error.
-    int read_events();
+    // Wait up to timeout milliseconds (-1 waits forever) for events, then
+    // read the pending events of each ready device with a single read.
+    // Returns the number of key events that were read.
+    int read_events(const int timeout = 0);
+
+    // Wake a thread blocked in read_events. This may be called from any
+    // thread.
+    void interrupt();
+
+    // Return the key press and release events found by the last call to
+    // read_events, in the order they occurred. Event times are taken from
+    // the monotonic clock.
+    const std::vector<struct input_event>& events() const;
 
     // Return true if the given key is down.
     bool is_down(const int keycode) const;
 
-    // Return true if an event is pending.
-    bool is_event_pending() const;
+    // Return the number of devices currently being read.
+    int device_count() const;
 
   private:
+    // Create the epoll set used to wait for devices.
+    void create_wait_set();
+
+    // Start reading events from the given device. The offset in microseconds
+    // is added to the time of each event read from it.
+    void add_device(const int fd, const int64_t offset = 0);
+
+    // Stop reading events from the given device and close it.
+    void remove_device(const int fd);
+
     // The state of all keys
     bool keymap[256];
 
-    // The file-descriptor of the given input device
-    int input_device_fd;
+    // Key events read by the last call to read_events
+    std::vector<struct input_event> key_events;
+
+    // The file-descriptors of all input devices
+    std::vector<int> device_fds;
+
+    // The offset added to event times of each device, in the same order as
+    // device_fds. This is non-zero for devices stamped with the realtime clock.
+    std::vector<int64_t> clock_offsets;
+
+    // The epoll set used to wait for devices
+    int epoll_fd;
+
+    // An eventfd used to wake a waiting reader
+    int wake_fd;
 };
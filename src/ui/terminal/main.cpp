@@ -3,53 +3,219 @@
 //
 // The frontend entry point for the terminal interface.
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <clocale>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
 #include <ratio>
 #include <thread>
 
 #include <mpe/engine.hpp>
+#include <mpe/histogram.hpp>
+#include <mpe/scheduler.hpp>
+#include <mpe/snapshot.hpp>
+#include <mpe/trace.hpp>
+#include <mpe/triple_buffer.hpp>
 #include <ui/terminal/graphics.hpp>
 
+// Frames drawn per second. The engine tick rate is set separately through
+// mpe::option::tickrate, and may be far higher.
 constexpr int framerate = 60;
 
-// Tick rate specifies the number of engine updates per second. Tickrates
-// should be a multiple of the framerate to mean anything.
-constexpr int tickrate = framerate;
+constexpr std::chrono::duration<int, std::ratio<1, framerate>> frametime(1);
 
-// It makes no sense for tickrate to be less than framerate
-static_assert(tickrate >= framerate);
+// Longest time the game sleeps without publishing a snapshot, so that the
+// clock on screen keeps moving while nothing else does.
+constexpr std::chrono::milliseconds idle_refresh(250);
 
-constexpr std::chrono::duration<int, std::ratio<1, tickrate>> ticktime(1);
+// Write the game statistics and timing histograms as a JSON object.
+static void write_timing(const char *path, const mpe::engine &engine,
+        const mpe::histogram &tick_time, const mpe::histogram &render_time,
+        const mpe::histogram &photon_time, const mpe::scheduler &scheduler)
+{
+    FILE *fd = std::fopen(path, "w");
+    if (!fd) {
+        std::perror("Error opening timing output");
+        return;
+    }
+
+    const mpe::statistics &stats = engine.statistics;
+    std::fprintf(fd, "{\"tickrate\":%d,\"ticks\":%d,\"blocks\":%d,"
+            "\"lines\":%d,\"dropped_ticks\":%lld,",
+            stats.tickrate, engine.ticks, stats.blocks_placed,
+            stats.lines_cleared, (long long) scheduler.dropped_ticks());
+
+    std::fprintf(fd, "\"tick_ns\":");
+    tick_time.dump_json(fd);
+    std::fprintf(fd, ",\"render_ns\":");
+    render_time.dump_json(fd);
+    std::fprintf(fd, ",\"overshoot_ns\":");
+    scheduler.overshoot_histogram().dump_json(fd);
+    std::fprintf(fd, ",\"input_latency_ns\":");
+    engine.input_latency.dump_json(fd);
+    std::fprintf(fd, ",\"input_to_photon_ns\":");
+    photon_time.dump_json(fd);
+    std::fprintf(fd, "}\n");
+
+    std::fclose(fd);
+}
 
 int main(int argc, char **argv)
 {
     // Ensure we aren't using the C/Ascii locale so unicode characters render
     std::setlocale(LC_ALL, "");
-    mpe::engine engine;
 
-    bool unicode = argc > 1 ? false : true;
+    mpe::option option;
+    bool unicode = true;
+    const char *timing_path = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--tickrate=", 11) == 0)
+            option.tickrate = std::max(1, std::atoi(argv[i] + 11));
+        else if (std::strncmp(argv[i], "--timing=", 9) == 0)
+            timing_path = argv[i] + 9;
+        else
+            unicode = false;
+    }
+
+    // Time spent in each engine update and each render, and from each key
+    // event until the frame showing it was written
+    mpe::histogram tick_time;
+    mpe::histogram render_time;
+    mpe::histogram photon_time;
+
+    MPE_TRACE_THREAD("game");
+
+    mpe::engine engine(option);
+
+    // Ticks follow a fixed timeline from the start of the game
+    const std::chrono::nanoseconds ticktime(1000000000 / option.tickrate);
+    mpe::scheduler scheduler(ticktime);
 
     // Close the graphics class seperately so that we can perform actions
     // once the graphics context has been cleared.
     {
         graphics gfx(unicode);
 
+        // The simulation publishes a snapshot after every update and the
+        // render thread draws the latest one, so a slow terminal never delays
+        // a tick. The render thread sleeps while nothing is published.
+        mpe::triple_buffer<mpe::snapshot> snapshots;
+        std::atomic<bool> rendering(true);
+        std::mutex frame_mutex;
+        std::condition_variable frame_ready;
+
+        std::thread render_thread([&] {
+            MPE_TRACE_THREAD("render");
+
+            typedef std::chrono::steady_clock clock;
+            const auto frame =
+                std::chrono::duration_cast<clock::duration>(frametime);
+            auto next_frame = clock::now();
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(frame_mutex);
+                    frame_ready.wait(lock, [&] {
+                        return snapshots.fresh() ||
+                               !rendering.load(std::memory_order_relaxed);
+                    });
+                }
+
+                if (!rendering.load(std::memory_order_relaxed))
+                    break;
+
+                snapshots.acquire();
+
+                const auto render_start = clock::now();
+                gfx.render(snapshots.read_buffer());
+                render_time.record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(clock::now() -
+                                              render_start).count());
+
+                // Limit drawing to the frame rate
+                next_frame = std::max(next_frame + frame, clock::now());
+                std::this_thread::sleep_until(next_frame);
+            }
+        });
+
+        // Was the last snapshot replaced before the renderer took it?
+        bool replaced = false;
+
+        const int64_t max_idle = std::max<int64_t>(1,
+                option.tickrate * idle_refresh.count() / 1000);
+
         while (engine.running) {
-            auto next_time_point = std::chrono::steady_clock::now() + ticktime;
+            // Sleep through ticks in which nothing can happen, waking early
+            // if input arrives. Otherwise run every tick that is due,
+            // catching up if we fell behind.
+            const int64_t idle = std::min(engine.idle_ticks(), max_idle);
+            const int64_t ticks = scheduler.wait(idle,
+                [&](const std::chrono::steady_clock::time_point until) {
+                    gfx.wait(until);
+                });
+
+            gfx.update(engine);
+            for (int64_t i = 0; i < ticks && engine.running; ) {
+                // Ticks which would only advance time are skipped in one go,
+                // so game time stays exact without running each of them
+                const int64_t n = std::min(engine.idle_ticks(), ticks - i);
+                if (n > 0) {
+                    engine.skip(n);
+                    i += n;
+                    continue;
+                }
 
-            // Limit draw phase to 60 frames regardless of internal tick counter
-            if (engine.ticks % (tickrate / framerate) == 0) {
-                gfx.render(engine);
-                gfx.update(engine);
+                // Key events up to the scheduled time of this tick are applied
+                const auto tick_start = std::chrono::steady_clock::now();
+                engine.update(scheduler.tick_time_us(i));
+                tick_time.record(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - tick_start).count());
+                i += 1;
             }
 
-            engine.update();
+            snapshots.write_buffer().capture(engine, replaced);
+            engine.clear_dirty();
+            {
+                std::lock_guard<std::mutex> lock(frame_mutex);
+                replaced = snapshots.publish();
+            }
+            frame_ready.notify_one();
+        }
 
-            // TODO: This assumes that we will complete processing in one frame
-            std::this_thread::sleep_until(next_time_point);
+        {
+            std::lock_guard<std::mutex> lock(frame_mutex);
+            rendering.store(false, std::memory_order_relaxed);
         }
+        frame_ready.notify_one();
+        render_thread.join();
+
+        photon_time = gfx.input_to_photon();
     }
 
     engine.statistics.dump();
+
+    std::printf("Tick Jitter: %.1fus mean, %lldus max\n",
+            scheduler.mean_jitter(), (long long) scheduler.max_jitter());
+    std::printf("Dropped Ticks: %lld\n", (long long) scheduler.dropped_ticks());
+
+    tick_time.dump("Tick Time");
+    render_time.dump("Render Time");
+    scheduler.overshoot_histogram().dump("Sleep Overshoot");
+    engine.input_latency.dump("Input Latency");
+    photon_time.dump("Input To Photon");
+
+    if (timing_path) {
+        write_timing(timing_path, engine, tick_time, render_time,
+                photon_time, scheduler);
+    }
+
+    // Every other thread has finished, so the trace is complete
+    MPE_TRACE_DUMP("mpe-trace.json");
 }
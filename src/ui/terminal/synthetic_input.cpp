@@ -0,0 +1,65 @@
+///
+// synthetic_input.cpp
+//
+// Implementation of the fake keyboard device.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ui/terminal/synthetic_input.hpp>
+
+synthetic_input::synthetic_input()
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        std::perror("Error creating synthetic input device");
+        std::exit(1);
+    }
+
+    read_fd = fds[0];
+    write_fd = fds[1];
+}
+
+synthetic_input::~synthetic_input()
+{
+    close(write_fd);
+}
+
+int synthetic_input::fd()
+{
+    return read_fd;
+}
+
+int64_t synthetic_input::press(const int code)
+{
+    return send(code, 1);
+}
+
+int64_t synthetic_input::release(const int code)
+{
+    return send(code, 0);
+}
+
+int64_t synthetic_input::send(const int code, const int value)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    struct input_event event = {};
+    event.time.tv_sec = now.tv_sec;
+    event.time.tv_usec = now.tv_nsec / 1000;
+    event.type = EV_KEY;
+    event.code = code;
+    event.value = value;
+
+    // Writes this small to a pipe are atomic, so only an interrupted write
+    // needs to be retried.
+    while (write(write_fd, &event, sizeof(event)) == -1 && errno == EINTR)
+        ;
+
+    return int64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
@@ -0,0 +1,44 @@
+///
+// synthetic_input.hpp
+//
+// A fake keyboard which produces input_event records on a pipe. The read end
+// can be given to linux_input (or input_thread) in place of a real device, so
+// the game can be driven without a keyboard or access to /dev/input, such as
+// when measuring latency in a headless test.
+
+#pragma once
+
+#include <cstdint>
+
+// File inclusions will usually require the enumeration definitions.
+#include <linux/input.h>
+
+class synthetic_input
+{
+  public:
+    // Create the pipe. If it cannot be created, exit with an error.
+    synthetic_input();
+
+    // Close the writing end, which the reader sees as the device going away.
+    ~synthetic_input();
+
+    synthetic_input(const synthetic_input&) = delete;
+    synthetic_input& operator=(const synthetic_input&) = delete;
+
+    // Return the reading end of the device. Ownership passes to the caller,
+    // so this must only be called once.
+    int fd();
+
+    // Send a key press or release, timestamped with the monotonic clock as
+    // the kernel would for a real device. Returns the time in microseconds.
+    int64_t press(int code);
+    int64_t release(int code);
+
+  private:
+    // Write a single key event with the current time.
+    int64_t send(int code, int value);
+
+    // The reading and writing ends of the pipe
+    int read_fd;
+    int write_fd;
+};
@@ -0,0 +1,320 @@
+///
+// termdraw.cpp
+//
+// Implementation of the double-buffered terminal renderer.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sys/ioctl.h>
+
+#include <ui/terminal/termdraw.hpp>
+
+// Copyright (c) 2008-2009 Bjoern Hoehrmann <bjoern@hoehrmann.de>
+// See http://bjoern.hoehrmann.de/utf-8/decoder/dfa/ for details.
+
+#define UTF8_ACCEPT 0
+#define UTF8_REJECT 1
+
+namespace {
+    static const uint8_t utf8d[] = {
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 00..1f
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 20..3f
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 40..5f
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 60..7f
+      1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9, // 80..9f
+      7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7, // a0..bf
+      8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2, // c0..df
+      0xa,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x4,0x3,0x3, // e0..ef
+      0xb,0x6,0x6,0x6,0x5,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8, // f0..ff
+      0x0,0x1,0x2,0x3,0x5,0x8,0x7,0x1,0x1,0x1,0x4,0x6,0x1,0x1,0x1,0x1, // s0..s0
+      1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,0,1,0,1,1,1,1,1,1, // s1..s2
+      1,2,1,1,1,1,1,2,1,2,1,1,1,1,1,1,1,1,1,1,1,1,1,2,1,1,1,1,1,1,1,1, // s3..s4
+      1,2,1,1,1,1,1,1,1,2,1,1,1,1,1,1,1,1,1,1,1,1,1,3,1,3,1,1,1,1,1,1, // s5..s6
+      1,3,1,1,1,1,1,3,1,3,1,1,1,1,1,1,1,3,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // s7..s8
+    };
+
+    uint32_t inline decode(uint32_t* state, uint32_t* codep, uint32_t byte) {
+        uint32_t type = utf8d[byte];
+
+        *codep = (*state != UTF8_ACCEPT) ?
+            (byte & 0x3fu) | (*codep << 6) :
+            (0xff >> type) & (byte);
+
+        *state = utf8d[256 + *state*16 + type];
+        return *state;
+    }
+
+    // Append the utf-8 encoding of a codepoint.
+    void encode(std::string &out, const uint32_t c)
+    {
+        if (c < 0x80) {
+            out += char(c);
+        }
+        else if (c < 0x800) {
+            out += char(0xc0 | (c >> 6));
+            out += char(0x80 | (c & 0x3f));
+        }
+        else if (c < 0x10000) {
+            out += char(0xe0 | (c >> 12));
+            out += char(0x80 | ((c >> 6) & 0x3f));
+            out += char(0x80 | (c & 0x3f));
+        }
+        else {
+            out += char(0xf0 | (c >> 18));
+            out += char(0x80 | ((c >> 12) & 0x3f));
+            out += char(0x80 | ((c >> 6) & 0x3f));
+            out += char(0x80 | (c & 0x3f));
+        }
+    }
+
+} // anonymous namespace
+
+namespace termdraw {
+
+// Size used when the output is not a terminal
+static constexpr int c_fallback_width = 80;
+static constexpr int c_fallback_height = 24;
+
+window::window(const int fd_) :
+    height(0), width(0), fd(fd_), cursor_x(0), cursor_y(0), touched(true),
+    last_bytes(0)
+{
+    is_tty = isatty(fd) && tcgetattr(fd, &saved) == 0;
+
+    // Keys pressed while playing should not be echoed over the screen
+    if (is_tty) {
+        struct termios raw = saved;
+        raw.c_lflag &= ~(ECHO | ICANON);
+        tcsetattr(fd, TCSANOW, &raw);
+    }
+
+    // Alternate screen, hidden cursor and no automatic wrapping
+    out = "\e[?1049h\e[?25l\e[?7l";
+    resize();
+}
+
+window::~window()
+{
+    out += "\e[0m\e[?7h\e[?25h\e[?1049l";
+    flush();
+
+    // Discard keys typed while playing so they aren't dumped on exit
+    if (is_tty) {
+        tcflush(fd, TCIFLUSH);
+        tcsetattr(fd, TCSANOW, &saved);
+    }
+}
+
+void window::resize()
+{
+    struct winsize ws;
+    if (ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col) {
+        height = ws.ws_row;
+        width  = ws.ws_col;
+    }
+    else {
+        height = c_fallback_height;
+        width  = c_fallback_width;
+    }
+
+    back.assign(width * height, cell());
+    front.assign(width * height, cell());
+
+    // The front buffer now describes a cleared screen
+    out += "\e[0m\e[2J";
+    term_x = -1;
+    term_y = -1;
+    term_style = style();
+    touched = true;
+}
+
+void window::erase()
+{
+    std::fill(back.begin(), back.end(), cell());
+    touched = true;
+}
+
+void window::clear(const int x, const int y, const int w, const int h)
+{
+    const int x0 = std::max(x, 0), x1 = std::min(x + w, width);
+    const int y0 = std::max(y, 0), y1 = std::min(y + h, height);
+
+    for (int row = y0; row < y1; ++row) {
+        std::fill(back.begin() + row * width + x0,
+                  back.begin() + row * width + x1, cell());
+        touched = true;
+    }
+}
+
+void window::set_style(const struct style &style)
+{
+    current = style;
+}
+
+void window::reset_style()
+{
+    current = style();
+}
+
+void window::move(const int x, const int y)
+{
+    cursor_x = x;
+    cursor_y = y;
+}
+
+bool window::puts(const char *str)
+{
+    uint32_t codepoint;
+    uint32_t state = 0;
+
+    for (; *str; ++str) {
+        switch (decode(&state, &codepoint, (unsigned char) *str)) {
+          case UTF8_ACCEPT:
+            if (cursor_x >= 0 && cursor_x < width &&
+                    cursor_y >= 0 && cursor_y < height) {
+                cell &c = back[cursor_y * width + cursor_x];
+                c.codepoint = codepoint;
+                c.style = current;
+                touched = true;
+            }
+            cursor_x += 1;
+            break;
+          case UTF8_REJECT:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool window::mvputs(const int x, const int y, const char *str)
+{
+    move(x, y);
+    return puts(str);
+}
+
+void window::update()
+{
+    if (!touched && out.empty()) {
+        last_bytes = 0;
+        return;
+    }
+    touched = false;
+
+    for (int y = 0; y < height; ++y) {
+        const cell *b = &back[y * width];
+        cell *f = &front[y * width];
+
+        int x = 0;
+        while (x < width) {
+            if (b[x] == f[x]) {
+                x += 1;
+                continue;
+            }
+
+            // Extend the run over any short gaps of unchanged cells, since
+            // rewriting them is cheaper than moving the cursor past them.
+            int last = x;
+            for (int i = x + 1; i < width && i - last <= c_max_gap; ++i) {
+                if (b[i] != f[i])
+                    last = i;
+            }
+
+            emit_move(x, y);
+            for (; x <= last; ++x) {
+                emit_cell(x, b[x]);
+                f[x] = b[x];
+            }
+        }
+    }
+
+    flush();
+}
+
+size_t window::bytes_written() const
+{
+    return last_bytes;
+}
+
+void window::emit_move(const int x, const int y)
+{
+    char buf[32];
+
+    if (y == term_y && x == term_x)
+        return;
+
+    if (y == term_y && term_x >= 0 && x > term_x) {
+        if (x - term_x == 1)
+            out += "\e[C";
+        else {
+            std::snprintf(buf, sizeof(buf), "\e[%dC", x - term_x);
+            out += buf;
+        }
+    }
+    else if (x == 0 && term_y >= 0 && y == term_y + 1) {
+        out += "\r\n";
+    }
+    else {
+        std::snprintf(buf, sizeof(buf), "\e[%d;%dH", y + 1, x + 1);
+        out += buf;
+    }
+
+    term_x = x;
+    term_y = y;
+}
+
+void window::emit_style(const struct style &style)
+{
+    char buf[16];
+
+    if (style == term_style)
+        return;
+
+    out += "\e[0";
+    if (style.attr & c_attr_bold)
+        out += ";1";
+    if (style.attr & c_attr_reverse)
+        out += ";7";
+    if (style.fg != c_default_color) {
+        std::snprintf(buf, sizeof(buf), ";38;5;%d", style.fg);
+        out += buf;
+    }
+    if (style.bg != c_default_color) {
+        std::snprintf(buf, sizeof(buf), ";48;5;%d", style.bg);
+        out += buf;
+    }
+    out += 'm';
+
+    term_style = style;
+}
+
+void window::emit_cell(const int x, const cell &c)
+{
+    emit_style(c.style);
+    encode(out, c.codepoint);
+
+    // The cursor stays on the last column once it is reached, so its
+    // position is only known while it is left of it.
+    term_x = x + 1 < width ? x + 1 : -1;
+}
+
+void window::flush()
+{
+    last_bytes = out.size();
+
+    size_t done = 0;
+    while (done < out.size()) {
+        const ssize_t n = write(fd, out.data() + done, out.size() - done);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            break;
+        }
+        done += n;
+    }
+
+    out.clear();
+}
+
+} // namespace termdraw
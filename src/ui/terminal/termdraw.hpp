@@ -4,195 +4,151 @@
 // A simplistic C++ ncurses-like file for easier drawing to a terminal. This is
 // not intended to match the scope of ncurses, and many comparable features
 // will be missing. Portability is limited to terminals which support vt100
-// escape codes.
+// escape codes and 256 colours.
 //
 // We implement a simple double-buffering system and the ability to draw onto a
-// single terminal instance.
-
-#include <stdint.h>
-#include <sys/ioctl.h>
+// single terminal instance. Drawing only touches the back buffer. On update
+// the back buffer is compared against the front buffer, which holds what the
+// terminal is currently showing, and only the cells which differ are sent.
+// Changed cells on a row are coalesced into runs so that each run costs one
+// cursor movement, and colours are only emitted where they change. The whole
+// frame is assembled in memory and flushed with a single write().
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <termios.h>
 #include <unistd.h>
 
-#include <clocale>
-
-// Copyright (c) 2008-2009 Bjoern Hoehrmann <bjoern@hoehrmann.de>
-// See http://bjoern.hoehrmann.de/utf-8/decoder/dfa/ for details.
-
-#define UTF8_ACCEPT 0
-#define UTF8_REJECT 1
-
-namespace {
-    static const uint8_t utf8d[] = {
-      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 00..1f
-      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 20..3f
-      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 40..5f
-      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // 60..7f
-      1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9,9, // 80..9f
-      7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7, // a0..bf
-      8,8,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2, // c0..df
-      0xa,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x3,0x4,0x3,0x3, // e0..ef
-      0xb,0x6,0x6,0x6,0x5,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8,0x8, // f0..ff
-      0x0,0x1,0x2,0x3,0x5,0x8,0x7,0x1,0x1,0x1,0x4,0x6,0x1,0x1,0x1,0x1, // s0..s0
-      1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,1,1,0,1,0,1,1,1,1,1,1, // s1..s2
-      1,2,1,1,1,1,1,2,1,2,1,1,1,1,1,1,1,1,1,1,1,1,1,2,1,1,1,1,1,1,1,1, // s3..s4
-      1,2,1,1,1,1,1,1,1,2,1,1,1,1,1,1,1,1,1,1,1,1,1,3,1,3,1,1,1,1,1,1, // s5..s6
-      1,3,1,1,1,1,1,3,1,3,1,1,1,1,1,1,1,3,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // s7..s8
-    };
-
-    uint32_t inline decode(uint32_t* state, uint32_t* codep, uint32_t byte) {
-        uint32_t type = utf8d[byte];
-
-        *codep = (*state != UTF8_ACCEPT) ?
-            (byte & 0x3fu) | (*codep << 6) :
-            (0xff >> type) & (byte);
-
-        *state = utf8d[256 + *state*16 + type];
-        return *state;
-    }
+namespace termdraw {
 
-} // anonymous namespace
+// The colour used when a cell does not specify one
+static constexpr int16_t c_default_color = -1;
 
-namespace termdraw {
+// Attribute bits of a cell
+static constexpr uint8_t c_attr_reverse = 1;
+static constexpr uint8_t c_attr_bold = 2;
 
-///
-// A window is the current terminal window context. By default this is made as
-// large as possible.
-class window {
+// Longest run of unchanged cells which is rewritten rather than skipped with
+// a cursor movement. Moving the cursor costs at least four bytes.
+static constexpr int c_max_gap = 3;
 
-    window() : cursor(0)
-    {
-        // Adjust the initial locale
-        std::setlocale(LC_ALL, "");
+// Longest string produced by a single printf call
+static constexpr int c_max_printf = 256;
 
-        _retrieve_window_dimensions();
+///
+// The colours and attributes used to draw a cell. Colours are indices into the
+// xterm 256 colour palette, or c_default_color.
+struct style
+{
+    int16_t fg = c_default_color;
+    int16_t bg = c_default_color;
+    uint8_t attr = 0;
 
-        // Setup signal handler for terminal resize
-        signal(SIGWINCH, _handle_window_resize);
+    bool operator==(const style &other) const
+    {
+        return fg == other.fg && bg == other.bg && attr == other.attr;
     }
 
-    void _handle_window_resize(int signal)
+    bool operator!=(const style &other) const
     {
-        // Disable signal handler during processing
-        signal(SIGWINCH, SIG_IGN);
+        return !(*this == other);
+    }
+};
 
-        _retrieve_window_dimensions();
+///
+// A single character position on the terminal.
+struct cell
+{
+    uint32_t codepoint = ' ';
+    struct style style;
 
-        // Restore signal handler
-        signal(SIGWINCH, _handle_window_resize);
+    bool operator==(const cell &other) const
+    {
+        return codepoint == other.codepoint && style == other.style;
     }
 
-    void _retrieve_window_dimensions()
+    bool operator!=(const cell &other) const
     {
-        struct winsize ws;
-        ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
-        height = ws.ws_row;
-        width  = ws.ws_col;
-        back.resize(width * height);
-        front.resize(width * height);
+        return !(*this == other);
     }
+};
 
-    // Insert a codepoint into the backbuffer and update the cursor, wrapping
-    // back to the start if required.
-    void _insert_into_backbuffer(size_t &cursor, const uint32_t codepoint)
-    {
-        if (cursor >= backbuffer.size())
-            cursor = 0;
+///
+// A window is the current terminal window context. By default this is made as
+// large as possible.
+class window
+{
+  public:
+    ///----------------
+    // Member Functions
+    ///---
 
-        backbuffer[cursor++] = codepoint;
-    }
+    // Take over the terminal on the given file descriptor, switching to the
+    // alternate screen and disabling echo.
+    explicit window(int fd = STDOUT_FILENO);
 
-    // Clear the entire screen. This occurs immediately and does not require an
-    // update call.
-    void clear(void)
-    {
-        std::puts("\e[2J\e[H");
-        std::fill(buffers->back().begin(), buffers->back().end(), 0);
-    }
+    // Restore the terminal to the state it was found in.
+    ~window();
 
-    // Save the entire screen contents.
-    void save_and_clear(void)
-    {
-        std::puts("\e7\e[?47h");
-        std::fill(buffers->back().begin(), buffers->back().end(), 0);
-    }
+    window(const window&) = delete;
+    window& operator=(const window&) = delete;
 
-    // Restore a saved screen
-    void restore(void)
-    {
-        std::puts("\e[?47l");
-    }
+    // Re-read the terminal dimensions. The buffers are resized and the next
+    // update redraws the entire screen.
+    void resize();
 
-    // Decode the given string as as utf-8 and insert into the backbuffer. If
-    // the string is invalid utf-8, then we discard any remaining values and
-    // return false.
-    bool puts(const char *str)
-    {
-        uint32_t codepoint;
-        uint32_t state = 0;
-
-        for (; *str; ++str) {
-            switch (decode(&state, &codepoint, *str)) {
-              case UTF8_ACCEPT:
-                _insert_into_backbuffer(cursor, codepoint);
-                break;
-              case UTF8_REJECT:
-                return false;
-            }
-        }
-
-        return true;
-    }
+    // Clear the back buffer. Nothing is sent until the next update.
+    void erase();
 
-    bool mvputs(const int x, const int y, const char *str)
-    {
-        cursor = y * width + x;
-        return puts(str);
-    }
+    // Clear a rectangle of the back buffer.
+    void clear(int x, int y, int w, int h);
+
+    // Set the style used by subsequent drawing calls.
+    void set_style(const struct style &style);
+
+    // Reset the style used by subsequent drawing calls to the default.
+    void reset_style();
+
+    // Move the drawing cursor to the specified position.
+    void move(int x, int y);
+
+    // Decode the given string as as utf-8 and insert into the backbuffer at
+    // the cursor. Cells outside of the window are discarded. If the string is
+    // invalid utf-8, then we discard any remaining values and return false.
+    bool puts(const char *str);
+
+    bool mvputs(int x, int y, const char *str);
 
     template <typename... Ts>
     bool printf(const char *fmt, Ts... ts)
     {
-        // Save the current width in case of signal mid-function
-        const size_t width_point = width;
-
-        // Assume that one would never want to print longer than a terminal row
-        char buf[width_point];
-        std::snprintf(buffer, width_point, fmt, ts...);
-
+        char buf[c_max_printf];
+        std::snprintf(buf, sizeof(buf), fmt, ts...);
         return puts(buf);
     }
 
     template <typename... Ts>
-    bool mvprintf(const int x, const int y, const char *fmt, Ts... ts)
+    bool mvprintf(int x, int y, const char *fmt, Ts... ts)
     {
-        cursor = y * width + x;
+        move(x, y);
         return printf(fmt, ts...);
     }
 
-    // Perform the actual writing out and swapping of buffers
-    void update()
-    {
-        auto back = buffers->back();
-        auto frnt = buffers->front();
-
-        // Iterate over the backbuffer, writing any changes as we come to them
-        for (int i = 0; i < back.size(); ++i) {
-            if (back[i] != front[i]) {
-                // Write out this codepoint
-                const int x = i % width;
-                const int y = i / width;
-
-                // Move to absolute position
-                std::printf("\e12414");
-                std::printf("%c", codepoint);
-
-                front[i] = back[i];
-            }
-        }
-    }
+    // Send the differences between the back and front buffers to the terminal
+    // and make the front buffer match the back buffer. If nothing has been
+    // drawn since the last update this returns immediately.
+    void update();
 
-    ///
-    // Variables
+    // Return the number of bytes sent by the last update.
+    size_t bytes_written() const;
+
+    ///----------------
+    // Member Variables
+    ///---
 
     // The height of the terminal window in characters
     int height;
@@ -200,24 +156,55 @@ class window {
     // The width of the terminal window in characters
     int width;
 
-    // Current terminal cursor position
-    size_t cursor;
+  private:
+    // Append the movement of the terminal cursor to the specified position.
+    void emit_move(int x, int y);
 
-    // Backbuffer storing current write state
-    std::vector<uint32_t> back;
+    // Append a change of the terminal style if it differs from the current.
+    void emit_style(const struct style &style);
 
-    // Frontbuffer storing current screen state
-    std::vector<uint32_t> front;
-};
+    // Append a single cell, advancing the terminal cursor.
+    void emit_cell(int x, const cell &c);
 
-} // namespace termdraw
+    // Write the output buffer to the terminal.
+    void flush();
 
-int main(void)
-{
-    termdraw::window window;
-    window.save();
+    // The file descriptor of the terminal
+    int fd;
+
+    // Is the file descriptor a terminal?
+    bool is_tty;
 
+    // Terminal attributes to restore on exit
+    struct termios saved;
 
+    // Current drawing position
+    int cursor_x;
+    int cursor_y;
 
-    window.restore();
-}
+    // Current drawing style
+    struct style current;
+
+    // Has the back buffer been written since the last update?
+    bool touched;
+
+    // Position and style of the terminal itself. A position of -1 means it
+    // is unknown.
+    int term_x;
+    int term_y;
+    struct style term_style;
+
+    // Backbuffer storing current write state
+    std::vector<cell> back;
+
+    // Frontbuffer storing current screen state
+    std::vector<cell> front;
+
+    // Bytes of the frame being assembled
+    std::string out;
+
+    // Number of bytes sent by the last update
+    size_t last_bytes;
+};
+
+} // namespace termdraw
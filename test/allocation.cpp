@@ -0,0 +1,155 @@
+///
+// allocation.cpp
+//
+// Guards against heap allocation in the steady state. The global allocator is
+// replaced (see bench/alloc_hook.hpp) so every allocation made by a tick,
+// snapshot capture or render is counted. Some storage is allocated on first
+// use, so each game is given a warm-up period, after which any allocation
+// fails the test.
+
+#include <cassert>
+#include <cstdio>
+#include <fcntl.h>
+#include <iterator>
+#include <random>
+#include <unistd.h>
+
+#include "bench/alloc_hook.hpp"
+#include "bench/games.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/snapshot.hpp"
+#include "ui/terminal/graphics.hpp"
+#include "ui/terminal/synthetic_input.hpp"
+
+// Ticks after the start of a game in which allocation is allowed
+static constexpr int64_t c_warmup_ticks = 60;
+
+// Seeds of the games played
+static constexpr unsigned c_seeds[] = {1, 2, 3};
+
+// Seed of the bot game which is recorded and replayed
+static constexpr unsigned c_replay_seed = 1;
+
+// Return the number of allocations made by the calling thread in fn.
+template <typename F>
+static uint64_t allocations(F fn)
+{
+    const uint64_t before = bench::thread_allocations().allocations;
+    fn();
+    return bench::thread_allocations().allocations - before;
+}
+
+// Fail if anything was allocated after the warm-up.
+static void check(const char *what, const mpe::engine &engine,
+                  const uint64_t count)
+{
+    if (count && engine.ticks > c_warmup_ticks) {
+        std::fprintf(stderr, "%s allocated %llu times on tick %d\n", what,
+                (unsigned long long) count, engine.ticks);
+        assert(!count);
+    }
+}
+
+///
+// Ticks and captures of a replayed game never allocate. Events are queued as
+// they fall due, as in a live game, and queueing them is checked along with
+// the tick.
+void t1(const bench::recording &game)
+{
+    mpe::option option;
+    option.seed = c_replay_seed;
+
+    bench::playback replay(option, game);
+    mpe::engine &engine = *replay.engine;
+    mpe::snapshot snapshot;
+
+    while (engine.running) {
+        check("update", engine, allocations([&] {
+            engine.update(replay.feed());
+        }));
+
+        check("capture", engine, allocations([&] {
+            snapshot.capture(engine);
+            engine.clear_dirty();
+        }));
+    }
+}
+
+///
+// Events queued while playing, including hold and hard drop, never allocate
+void t2()
+{
+    const mpe::keycode keys[] = {
+        mpe::keycode::left, mpe::keycode::right, mpe::keycode::down,
+        mpe::keycode::z, mpe::keycode::x, mpe::keycode::c,
+        mpe::keycode::space
+    };
+
+    for (const unsigned seed : c_seeds) {
+        mpe::option option;
+        option.seed = seed;
+
+        mpe::engine engine(option);
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> key(0, std::size(keys) - 1);
+
+        for (int i = 0; i < 60 * 60; ++i) {
+            const int64_t now = bench::tick_us(option, engine.ticks);
+            const mpe::keycode k = keys[key(generator)];
+
+            check("tick", engine, allocations([&] {
+                engine.push_event({now, k, !engine.keystate.down[k]});
+                engine.update(now);
+            }));
+        }
+    }
+}
+
+///
+// Rendering never allocates once the screen has been drawn
+void t3(const bench::recording &game)
+{
+    synthetic_input keys;
+    const int out = open("/dev/null", O_WRONLY);
+    assert(out != -1);
+
+    {
+        graphics gfx(true, {keys.fd()}, out);
+
+        mpe::option option;
+        option.seed = c_replay_seed;
+
+        bench::playback replay(option, game);
+        mpe::engine &engine = *replay.engine;
+        mpe::snapshot snapshot;
+
+        while (engine.running) {
+            engine.update(replay.feed());
+            snapshot.capture(engine);
+            engine.clear_dirty();
+
+            check("render", engine, allocations([&] {
+                gfx.render(snapshot);
+            }));
+        }
+    }
+
+    close(out);
+}
+
+int main(void)
+{
+    // The hook must be linked in for the counts to mean anything
+    assert(allocations([] {
+        int *volatile p = new int(0);
+        delete p;
+    }) == 1);
+
+    mpe::option option;
+    option.seed = c_replay_seed;
+    const bench::recording game = bench::record_bot_game(option);
+
+    t1(game);
+    t2();
+    t3(game);
+}
@@ -0,0 +1,105 @@
+///
+// bot.cpp
+//
+// Tests for the reference bot. The bot must finish a game, and its search
+// must not depend on the number of threads it uses.
+
+#include <cassert>
+#include <vector>
+
+#include "mpe/ai/bot.hpp"
+#include "mpe/engine.hpp"
+
+// Seed of the games played
+static constexpr unsigned c_seed = 1;
+
+// Ticks played when comparing bots
+static constexpr int c_compare_ticks = 600;
+
+// Return bot options with a narrow search, so that the tests run quickly.
+static mpe::ai::bot_option narrow()
+{
+    mpe::ai::bot_option option;
+    option.beam_width = 8;
+    option.depth = 3;
+    return option;
+}
+
+// Play up to the given number of ticks, returning the field hash after each
+// block is placed.
+static std::vector<uint64_t> play(const mpe::ai::bot_option &bot_option,
+                                  const int ticks)
+{
+    mpe::option option;
+    option.seed = c_seed;
+
+    mpe::engine engine(option);
+    mpe::ai::bot bot(bot_option);
+    std::vector<uint64_t> fields;
+
+    while (engine.running && engine.ticks < ticks) {
+        const int placed = engine.statistics.blocks_placed;
+
+        bot.update(engine);
+        engine.update();
+
+        if (engine.statistics.blocks_placed != placed)
+            fields.push_back(engine.field.hash);
+    }
+
+    return fields;
+}
+
+///
+// The bot clears the lines required to finish a game
+void t1()
+{
+    mpe::option option;
+    option.seed = c_seed;
+
+    mpe::engine engine(option);
+    mpe::ai::bot bot(narrow());
+
+    while (engine.running) {
+        bot.update(engine);
+        engine.update();
+    }
+
+    assert(engine.statistics.lines_cleared >= 40);
+    assert(engine.statistics.finesse == 0);
+}
+
+///
+// Searching on several threads places every block in the same place
+void t2()
+{
+    const mpe::ai::bot_option single = narrow();
+    mpe::ai::bot_option threaded = single;
+    threaded.threads = 4;
+
+    const std::vector<uint64_t> a = play(single, c_compare_ticks);
+    assert(a.size() > 10);
+    assert(a == play(threaded, c_compare_ticks));
+}
+
+///
+// The expectimax search is also independent of the number of threads
+void t3()
+{
+    mpe::ai::bot_option single = narrow();
+    single.expectimax = true;
+
+    mpe::ai::bot_option threaded = single;
+    threaded.threads = 4;
+
+    const std::vector<uint64_t> a = play(single, c_compare_ticks);
+    assert(a.size() > 10);
+    assert(a == play(threaded, c_compare_ticks));
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+}
@@ -0,0 +1,168 @@
+///
+// engine.cpp
+//
+// Tests for block movement in the engine under gravity and held keys.
+//
+// The default DAS of 133333us is 8 ticks at 60Hz, so a held direction moves
+// one cell on the first tick and begins repeating on the ninth.
+
+#include <cassert>
+
+#include "mpe/engine.hpp"
+
+using namespace mpe;
+
+// Block ids, in the order used by the randomizer
+static constexpr block_type c_i = 0;
+static constexpr block_type c_t = 1;
+
+// Ticks a direction is held before it repeats with the default options
+static constexpr int c_das_ticks = 8;
+
+// Return the y position the current block would land at.
+static int floor_y(const engine &engine)
+{
+    return engine.block.y - engine.block.drop_distance(engine.field);
+}
+
+///
+// Under 20G a block lands on the tick it spawns
+void t1()
+{
+    engine engine;
+    engine.gravity = c_gravity_instant;
+    assert(engine.block.drop_distance(engine.field) > 0);
+
+    engine.update();
+    assert(engine.block.drop_distance(engine.field) == 0);
+
+    // The next block is settled in the same tick as the hard drop
+    const int placed = engine.statistics.blocks_placed;
+    engine.keystate.key_down(keycode::space);
+    engine.update();
+    assert(engine.statistics.blocks_placed == placed + 1);
+    assert(engine.block.drop_distance(engine.field) == 0);
+}
+
+///
+// Gravity of several cells per tick falls that far each tick
+void t2()
+{
+    engine engine;
+    engine.gravity = 3 * 60 * c_gravity_unit;
+    engine.block = block(c_t);
+
+    const int start = engine.block.y;
+    engine.update();
+    assert(engine.block.y == start - 3);
+    engine.update();
+    assert(engine.block.y == start - 6);
+
+    // The last step stops on the floor rather than passing through it
+    for (int i = 0; i < engine.field.height; ++i)
+        engine.update();
+    assert(engine.block.y == floor_y(engine));
+}
+
+///
+// Fractional gravity carries over between ticks
+void t3()
+{
+    engine engine;
+    engine.gravity = c_gravity_unit * 60 / 64;
+    engine.block = block(c_t);
+
+    // One cell per 64 ticks at 60Hz
+    const int start = engine.block.y;
+    for (int i = 0; i < 63; ++i)
+        engine.update();
+    assert(engine.block.y == start);
+
+    engine.update();
+    assert(engine.block.y == start - 1);
+}
+
+///
+// An ARR of 0 shifts to the wall on the first tick after DAS charges
+void t4()
+{
+    option option;
+    option.arr = 0;
+    assert(option.das_ticks() == c_das_ticks);
+
+    engine engine(option);
+    engine.block = block(c_t);
+    engine.keystate.key_down(keycode::right);
+
+    for (int i = 0; i < c_das_ticks; ++i)
+        engine.update();
+    assert(engine.block.x == 4);
+
+    engine.update();
+    assert(engine.block.x == engine.field.width - 3);
+}
+
+///
+// A fractional ARR carries the remainder between ticks
+void t5()
+{
+    // 1.5 ticks per cell, so two cells are moved every three ticks
+    option option;
+    option.arr = 25000;
+    assert(option.arr_ticks() == 3 * c_arr_unit / 2);
+
+    // A vertical I has five cells to move before reaching the left wall
+    engine engine(option);
+    engine.block = block(c_i, 1);
+    engine.keystate.key_down(keycode::left);
+
+    for (int i = 0; i < c_das_ticks; ++i)
+        engine.update();
+    assert(engine.block.x == 2);
+
+    const int expected[] = {2, 1, 0, 0, -1, -2, -2};
+    for (const int x : expected) {
+        engine.update();
+        assert(engine.block.x == x);
+    }
+}
+
+///
+// An ARR shorter than a tick moves several cells each tick
+void t6()
+{
+    // A quarter of a tick per cell
+    option option;
+    option.arr = 16667 / 4;
+    assert(option.arr_ticks() == c_arr_unit / 4);
+
+    engine engine(option);
+    engine.block = block(c_i, 1);
+    engine.keystate.key_down(keycode::left);
+
+    for (int i = 0; i <= c_das_ticks; ++i)
+        engine.update();
+    assert(engine.block.x == -2);
+
+    // From the left wall, a held right moves four cells per tick
+    engine.keystate.key_up(keycode::left);
+    engine.keystate.key_down(keycode::right);
+    for (int i = 0; i < c_das_ticks; ++i)
+        engine.update();
+    assert(engine.block.x == -1);
+
+    engine.update();
+    assert(engine.block.x == 3);
+    engine.update();
+    assert(engine.block.x == engine.field.width - 3);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+    t4();
+    t5();
+    t6();
+}
@@ -0,0 +1,101 @@
+///
+// features.cpp
+//
+// Tests for board feature extraction on small hand-built fields.
+
+#include <cassert>
+
+#include "mpe/ai/features.hpp"
+#include "mpe/field.hpp"
+
+using namespace mpe::ai;
+
+///
+// An empty field only has transitions against the floor
+void t1()
+{
+    const mpe::field field;
+    const feature_vector f = extract_features(field);
+
+    for (int i = 0; i < feature_length; ++i) {
+        if (i != column_transitions)
+            assert(f[i] == 0);
+    }
+    assert(f[column_transitions] == field.width);
+}
+
+///
+// Three full rows with the right column open form a well three deep
+void t2()
+{
+    mpe::field field;
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < field.width - 1; ++x)
+            field.fill(x, y);
+    }
+
+    const feature_vector f = extract_features(field);
+    assert(f[holes] == 0);
+    assert(f[covered_cells] == 0);
+    assert(f[well_depth] == 3);
+
+    // Each row changes from filled to open at the well and back at the wall
+    assert(f[row_transitions] == 6);
+
+    // The well meets the floor, and nine columns end at the top of the stack
+    assert(f[column_transitions] == 10);
+
+    assert(f[max_height] == 3);
+    assert(f[aggregate_height] == 27);
+    assert(f[bumpiness] == 3);
+}
+
+///
+// A single raised cell covers two holes
+void t3()
+{
+    mpe::field field;
+    field.fill(4, 2);
+
+    const feature_vector f = extract_features(field);
+    assert(f[holes] == 2);
+    assert(f[covered_cells] == 1);
+    assert(f[well_depth] == 0);
+
+    // Four changes in the top row, and the walls of the two rows below it
+    assert(f[row_transitions] == 8);
+
+    // The empty bottom row against the floor, and both sides of the cell
+    assert(f[column_transitions] == 12);
+
+    assert(f[max_height] == 3);
+    assert(f[aggregate_height] == 3);
+    assert(f[bumpiness] == 6);
+}
+
+///
+// Holes are counted under every filled cell of a column, not just the top one
+void t4()
+{
+    mpe::field field;
+    field.fill(0, 1);
+    field.fill(0, 3);
+    field.fill(1, 0);
+
+    const feature_vector f = extract_features(field);
+    assert(f[holes] == 2);
+    assert(f[covered_cells] == 2);
+    assert(f[well_depth] == 0);
+
+    assert(f[max_height] == 4);
+    assert(f[aggregate_height] == 5);
+    assert(f[bumpiness] == 4);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+    t4();
+}
@@ -0,0 +1,234 @@
+///
+// finesse.cpp
+//
+// Tests for the finesse table against placements whose minimal inputs are
+// known, on an empty field with SRS wallkicks, and for the faults counted by
+// the engine when a block is placed with more inputs than needed.
+
+#include <cassert>
+#include <vector>
+
+#include "mpe/block.hpp"
+#include "mpe/engine.hpp"
+#include "mpe/field.hpp"
+#include "mpe/finesse.hpp"
+#include "mpe/wallkick/srs.hpp"
+
+using namespace mpe;
+
+// Block ids, in the order used by the randomizer
+static constexpr block_type c_i = 0;
+static constexpr block_type c_t = 1;
+static constexpr block_type c_o = 6;
+
+// Apply an input sequence to a block at spawn and hard drop it.
+static block play(const field &field, const wallkick::interface &srs,
+                  const block_type id,
+                  const std::vector<finesse_input> &inputs)
+{
+    block b(id);
+
+    for (const finesse_input input : inputs) {
+        switch (input) {
+          case tap_left:
+            assert(b.move_left(field));
+            break;
+          case tap_right:
+            assert(b.move_right(field));
+            break;
+          case das_left:
+            while (b.move_left(field)) {}
+            break;
+          case das_right:
+            while (b.move_right(field)) {}
+            break;
+          case rotate_ccw:
+            assert(b.rotate_left(field, srs));
+            break;
+          case rotate_cw:
+            assert(b.rotate_right(field, srs));
+            break;
+          default:
+            assert(false);
+        }
+    }
+
+    b.hard_drop(field);
+    return b;
+}
+
+// Press and release a key on consecutive engine ticks.
+static void tap(engine &engine, const keycode key)
+{
+    engine.keystate.key_down(key);
+    engine.update();
+    engine.keystate.key_up(key);
+    engine.update();
+}
+
+// Replace the current block of the engine with a fresh T block at spawn,
+// tap the given keys and hard drop it. Returns the engine's fault count.
+static int place(engine &engine, const std::vector<keycode> &keys)
+{
+    engine.block = block(c_t);
+
+    for (const keycode key : keys)
+        tap(engine, key);
+
+    const int placed = engine.statistics.blocks_placed;
+    tap(engine, keycode::space);
+    assert(engine.statistics.blocks_placed == placed + 1);
+
+    return engine.statistics.finesse;
+}
+
+// Check that the table entry for a placement has the expected number of
+// inputs, and that its sequence reaches the placement.
+static void check(const finesse_table &table, const wallkick::interface &srs,
+                  const block_type id, const rotation_type r, const int x,
+                  const int expected)
+{
+    const field empty;
+
+    assert(table.minimal(id, r, x) == expected);
+    assert((int) table.inputs(id, r, x).size() == expected);
+
+    block target(id, r);
+    target.x = x;
+    target.hard_drop(empty);
+
+    const block b = play(empty, srs, id, table.inputs(id, r, x));
+    for (int i = 0; i < c_block_cells; ++i) {
+        assert(b.x + b.data[i].x == target.x + target.data[i].x);
+        assert(b.y + b.data[i].y == target.y + target.data[i].y);
+    }
+}
+
+///
+// Placements reached with no input or a single input
+void t1()
+{
+    const wallkick::SRS srs;
+    const finesse_table table(srs);
+
+    // Dropped straight from spawn
+    check(table, srs, c_t, 0, 3, 0);
+    check(table, srs, c_o, 0, 3, 0);
+
+    // Against either wall
+    check(table, srs, c_t, 0, 0, 1);
+    check(table, srs, c_t, 0, 7, 1);
+
+    // One column over, or turned once
+    check(table, srs, c_o, 0, 2, 1);
+    check(table, srs, c_t, 1, 3, 1);
+    check(table, srs, c_t, 3, 3, 1);
+}
+
+///
+// Placements which take two inputs
+void t2()
+{
+    const wallkick::SRS srs;
+    const finesse_table table(srs);
+
+    // Two taps, or a DAS and a tap back from the wall
+    check(table, srs, c_t, 0, 1, 2);
+    check(table, srs, c_t, 0, 5, 2);
+    check(table, srs, c_t, 0, 6, 2);
+
+    // Turned upside down in place
+    check(table, srs, c_t, 2, 3, 2);
+
+    // Moved to the wall before turning, so no tap back is needed
+    check(table, srs, c_t, 1, 0, 2);
+
+    // A vertical I against either wall
+    check(table, srs, c_i, 3, -1, 2);
+    check(table, srs, c_i, 1, 7, 2);
+
+    // A flat I one column in from the left wall
+    check(table, srs, c_i, 0, 1, 2);
+}
+
+///
+// Placements which take three inputs
+void t3()
+{
+    const wallkick::SRS srs;
+    const finesse_table table(srs);
+
+    // Turned one column in from the left wall
+    check(table, srs, c_t, 1, 1, 3);
+
+    // Upside down against the left wall
+    check(table, srs, c_t, 2, 0, 3);
+
+    // Turned and moved two columns right
+    check(table, srs, c_t, 3, 5, 3);
+}
+
+///
+// Rotations covering the same cells share an entry, and columns off the
+// field are unreachable
+void t4()
+{
+    const wallkick::SRS srs;
+    const finesse_table table(srs);
+
+    for (int r = 0; r < 4; ++r)
+        assert(table.minimal(c_o, r, 3) == 0);
+
+    assert(table.minimal(c_t, 0, 8) == -1);
+    assert(table.inputs(c_t, 0, 8).empty());
+}
+
+///
+// Placing a block with its minimal inputs is not a fault
+void t5()
+{
+    engine engine;
+
+    // Two columns right takes two taps
+    assert(place(engine, {keycode::right, keycode::right}) == 0);
+
+    // Turned once in place
+    assert(place(engine, {keycode::x}) == 0);
+}
+
+///
+// Each input beyond the minimal number is a fault
+void t6()
+{
+    engine engine;
+
+    // Three columns right takes a DAS and a tap back, so three taps is one
+    // input too many
+    assert(finesse_table(*engine.wallkick).minimal(c_t, 0, 6) == 2);
+    assert(place(engine, {keycode::right, keycode::right, keycode::right}) ==
+           1);
+
+    // Turning three times instead of once the other way is two more
+    assert(place(engine, {keycode::x, keycode::x, keycode::x}) == 3);
+}
+
+///
+// Soft dropped blocks are not judged
+void t7()
+{
+    engine engine;
+
+    assert(place(engine, {keycode::right, keycode::left, keycode::down}) ==
+           0);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+    t4();
+    t5();
+    t6();
+    t7();
+}
@@ -0,0 +1,136 @@
+///
+// latency.cpp
+//
+// Tests for input to photon latency measurement. A synthetic keyboard drives
+// the game headless, with frames written to /dev/null, so no keyboard,
+// terminal or special permissions are required.
+
+#include <cassert>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mpe/engine.hpp"
+#include "mpe/snapshot.hpp"
+#include "ui/terminal/graphics.hpp"
+#include "ui/terminal/synthetic_input.hpp"
+
+typedef std::chrono::steady_clock clock_type;
+
+// Longest time any single event should take to reach the screen
+static constexpr std::chrono::seconds c_max_latency(1);
+
+// Return the current time in microseconds, as used for event timestamps.
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        clock_type::now().time_since_epoch()).count();
+}
+
+// Run one tick of the game loop: take any queued events, update the engine
+// and draw the result.
+static void tick(graphics &gfx, mpe::engine &engine, mpe::snapshot &snapshot)
+{
+    gfx.update(engine);
+    engine.update(now_us());
+    snapshot.capture(engine);
+    engine.clear_dirty();
+    gfx.render(snapshot);
+}
+
+///
+// Every event is measured once, in the first frame drawn after it is applied
+void t1()
+{
+    synthetic_input keys;
+    const int out = open("/dev/null", O_WRONLY);
+    assert(out != -1);
+
+    {
+        graphics gfx(true, {keys.fd()}, out);
+        mpe::engine engine;
+        mpe::snapshot snapshot;
+
+        // Frames without input are not measured
+        for (int i = 0; i < 3; ++i)
+            tick(gfx, engine, snapshot);
+        assert(gfx.input_to_photon().count() == 0);
+
+        const int codes[] = {KEY_LEFT, KEY_RIGHT, KEY_Z, KEY_X};
+        int sent = 0;
+
+        for (const int code : codes) {
+            for (const bool down : {true, false}) {
+                if (down)
+                    keys.press(code);
+                else
+                    keys.release(code);
+                sent += 1;
+
+                // Wait for the input thread to queue the event
+                gfx.wait(clock_type::now() + c_max_latency);
+                tick(gfx, engine, snapshot);
+
+                assert(gfx.input_to_photon().count() == sent);
+
+                // A quiet frame afterwards records nothing more
+                tick(gfx, engine, snapshot);
+                assert(gfx.input_to_photon().count() == sent);
+            }
+        }
+
+        const mpe::histogram &latency = gfx.input_to_photon();
+        assert(latency.min() > 0);
+        assert(latency.max() < std::chrono::duration_cast<
+               std::chrono::nanoseconds>(c_max_latency).count());
+    }
+
+    close(out);
+}
+
+///
+// Events merged into a single frame are measured from the earliest
+void t2()
+{
+    synthetic_input keys;
+    const int out = open("/dev/null", O_WRONLY);
+    assert(out != -1);
+
+    {
+        graphics gfx(true, {keys.fd()}, out);
+        mpe::engine engine;
+        mpe::snapshot snapshot;
+
+        tick(gfx, engine, snapshot);
+
+        const int64_t first = keys.press(KEY_LEFT);
+        usleep(2000);
+        keys.release(KEY_LEFT);
+
+        // Collect both events before running the tick which applies them
+        const auto until = clock_type::now() + c_max_latency;
+        while (engine.events.size() < 2 && clock_type::now() < until) {
+            gfx.wait(until);
+            gfx.update(engine);
+        }
+        assert(engine.events.size() == 2);
+
+        engine.update(now_us());
+        snapshot.capture(engine);
+        engine.clear_dirty();
+        gfx.render(snapshot);
+
+        const mpe::histogram &latency = gfx.input_to_photon();
+        assert(latency.count() == 1);
+        assert(latency.min() >= 2000 * 1000);
+        assert(latency.max() <= (now_us() - first + 1) * 1000);
+    }
+
+    close(out);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+}
@@ -0,0 +1,124 @@
+///
+// linux_input.cpp
+//
+// Tests for reading keyboard events. Pipes stand in for event devices, so no
+// keyboard or special permissions are required.
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+#include "ui/terminal/linux_input.hpp"
+
+// Write a key event with the given time (in microseconds) to a fake device.
+static void send(const int fd, const int code, const int value, const long time)
+{
+    struct input_event event = {};
+    event.time.tv_sec = time / 1000000;
+    event.time.tv_usec = time % 1000000;
+    event.type = EV_KEY;
+    event.code = code;
+    event.value = value;
+
+    const ssize_t written = write(fd, &event, sizeof(event));
+    assert(written == sizeof(event));
+}
+
+///
+// Events from multiple devices are merged in time order
+void t1()
+{
+    int a[2], b[2];
+    assert(pipe(a) == 0 && pipe(b) == 0);
+
+    linux_input input({a[0], b[0]});
+    assert(input.device_count() == 2);
+
+    send(a[1], KEY_LEFT, 1, 100);
+    send(b[1], KEY_Z, 1, 50);
+    send(a[1], KEY_LEFT, 0, 300);
+    send(b[1], KEY_Z, 2, 200);
+
+    assert(input.read_events() == 3);
+
+    const auto &events = input.events();
+    assert(events.size() == 3);
+    assert(events[0].code == KEY_Z && events[0].value == 1);
+    assert(events[1].code == KEY_LEFT && events[1].value == 1);
+    assert(events[2].code == KEY_LEFT && events[2].value == 0);
+
+    assert(input.is_down(KEY_Z));
+    assert(!input.is_down(KEY_LEFT));
+
+    // Nothing is pending, so a zero timeout returns straight away
+    assert(input.read_events() == 0);
+
+    close(a[1]);
+    close(b[1]);
+}
+
+///
+// More events than fit in a single read are picked up by later calls
+void t2()
+{
+    int a[2];
+    assert(pipe(a) == 0);
+
+    linux_input input({a[0]});
+
+    for (int i = 0; i < 100; ++i)
+        send(a[1], KEY_X, i % 2 == 0, i);
+
+    int total = 0;
+    while (int n = input.read_events())
+        total += n;
+
+    assert(total == 100);
+    close(a[1]);
+}
+
+///
+// Devices which go away are dropped
+void t3()
+{
+    int a[2], b[2];
+    assert(pipe(a) == 0 && pipe(b) == 0);
+
+    linux_input input({a[0], b[0]});
+    close(a[1]);
+
+    input.read_events();
+    assert(input.device_count() == 1);
+
+    send(b[1], KEY_C, 1, 0);
+    assert(input.read_events() == 1);
+    close(b[1]);
+}
+
+///
+// A blocked reader can be woken from another thread
+void t4()
+{
+    int a[2];
+    assert(pipe(a) == 0);
+
+    linux_input input({a[0]});
+
+    std::thread waker([&input] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        input.interrupt();
+    });
+
+    assert(input.read_events(-1) == 0);
+    waker.join();
+    close(a[1]);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+    t4();
+}
@@ -0,0 +1,127 @@
+///
+// reachability.cpp
+//
+// Tests that placements answered by the reachability cache are the same as
+// those found by a fresh search.
+
+#include <cassert>
+#include <vector>
+
+#include "mpe/ai/movegen.hpp"
+#include "mpe/ai/reachability.hpp"
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/wallkick/srs.hpp"
+
+using namespace mpe::ai;
+
+// Return a field with the given number of garbage rows. Each row has a single
+// hole, alternating between the walls so that only the top hole is open.
+static mpe::field garbage(const int rows)
+{
+    mpe::field field;
+    for (int y = 0; y < rows; ++y) {
+        const int hole = y % 2 ? field.width - 1 : 0;
+        for (int x = 0; x < field.width; ++x) {
+            if (x != hole)
+                field.fill(x, y);
+        }
+    }
+
+    return field;
+}
+
+// Return whether two placement lists are identical, including their order.
+static bool same(const std::vector<placement> &a,
+                 const std::vector<placement> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].id != b[i].id || a[i].x != b[i].x || a[i].y != b[i].y ||
+                a[i].r != b[i].r) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///
+// A cache hit returns the same placements as a fresh search
+void t1()
+{
+    const mpe::wallkick::SRS srs;
+    movegen gen(srs), fresh(srs);
+    reachability_cache cache;
+    std::vector<placement> out;
+
+    const mpe::field field = garbage(4);
+
+    for (int id = 0; id < 7; ++id) {
+        const mpe::block start(id);
+        const std::vector<placement> expected = fresh.generate(field, start);
+        assert(!expected.empty());
+
+        assert(same(cache.generate(gen, field, start, out), expected));
+        assert(cache.miss_count() == uint64_t(id + 1));
+
+        assert(same(cache.generate(gen, field, start, out), expected));
+        assert(cache.hit_count() == uint64_t(id + 1));
+    }
+}
+
+///
+// The same surface over more garbage is a hit, moved up to the new height
+void t2()
+{
+    const mpe::wallkick::SRS srs;
+    movegen gen(srs), fresh(srs);
+    reachability_cache cache;
+    std::vector<placement> out;
+
+    const mpe::block start(1);
+    const mpe::field low = garbage(8);
+    const mpe::field high = garbage(12);
+
+    cache.generate(gen, low, start, out);
+    assert(cache.miss_count() == 1);
+
+    const std::vector<placement> expected = fresh.generate(high, start);
+    assert(same(cache.generate(gen, high, start, out), expected));
+    assert(cache.hit_count() == 1);
+
+    // Every placement rests on the higher stack
+    for (const auto &p : expected)
+        assert(p.y >= 12);
+}
+
+///
+// Blocks away from their spawn position are searched directly
+void t3()
+{
+    const mpe::wallkick::SRS srs;
+    movegen gen(srs), fresh(srs);
+    reachability_cache cache;
+    std::vector<placement> out;
+
+    const mpe::field field = garbage(4);
+    mpe::block start(2);
+    start.x = 0;
+
+    const std::vector<placement> expected = fresh.generate(field, start);
+    assert(same(cache.generate(gen, field, start, out), expected));
+    assert(same(cache.generate(gen, field, start, out), expected));
+
+    assert(cache.hit_count() == 0);
+    assert(cache.miss_count() == 0);
+    assert(cache.uncacheable_count() == 2);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+}
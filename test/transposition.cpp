@@ -0,0 +1,149 @@
+///
+// transposition.cpp
+//
+// Tests for the Zobrist field hash and the transposition table.
+
+#include <cassert>
+
+#include "mpe/ai/transposition.hpp"
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+
+using namespace mpe::ai;
+
+// Buckets of the tables used by these tests are 2^c_bits
+static constexpr int c_bits = 4;
+
+///
+// A stored entry is returned by a probe with the same key and depth
+void t1()
+{
+    transposition_table table(c_bits);
+    transposition_entry entry;
+
+    table.store(0x1234, 0, 2.5f);
+    assert(table.probe(0x1234, 0, entry));
+    assert(entry.score == 2.5f && entry.depth == 0);
+
+    // The depth is part of the entry
+    assert(!table.probe(0x1234, 1, entry));
+
+    assert(table.probe_count() == 2);
+    assert(table.hit_count() == 1);
+}
+
+///
+// A key which shares a bucket fails the xor verification
+void t2()
+{
+    transposition_table table(c_bits);
+    transposition_entry entry;
+
+    const uint64_t key = 0x1234;
+    const uint64_t other = key + (1 << c_bits);
+
+    table.store(key, 0, 1.0f);
+    assert(!table.probe(other, 0, entry));
+
+    // Clearing removes the entry and the counters
+    table.clear();
+    assert(table.probe_count() == 0);
+    assert(!table.probe(key, 0, entry));
+}
+
+///
+// The deeper entry of a bucket survives a shallower store in the same search
+void t3()
+{
+    transposition_table table(c_bits);
+    transposition_entry entry;
+
+    const uint64_t a = 0x10, b = a + (1 << c_bits), c = b + (1 << c_bits);
+
+    table.age();
+    table.store(a, 1, 1.0f);
+    table.store(b, 0, 2.0f);
+    assert(table.probe(a, 1, entry) && entry.score == 1.0f);
+    assert(table.probe(b, 0, entry) && entry.score == 2.0f);
+
+    // The second slot is always replaced
+    table.store(c, 0, 3.0f);
+    assert(table.probe(a, 1, entry));
+    assert(!table.probe(b, 0, entry));
+    assert(table.probe(c, 0, entry) && entry.score == 3.0f);
+
+    // Entries from an older search are replaced first
+    table.age();
+    table.store(b, 0, 4.0f);
+    assert(!table.probe(a, 1, entry));
+    assert(table.probe(b, 0, entry) && entry.score == 4.0f);
+}
+
+///
+// The incremental field hash matches a field built directly
+void t4()
+{
+    mpe::field played;
+
+    // An I laid flat in the left corner and three O blocks beside it fill the
+    // bottom row. Clearing it leaves the top halves of the O blocks.
+    mpe::block i(0);
+    i.x = 0;
+    i.hard_drop(played);
+    played.place_block(i);
+
+    for (int x = 3; x <= 7; x += 2) {
+        mpe::block o(6);
+        o.x = x;
+        o.hard_drop(played);
+        played.place_block(o);
+    }
+
+    assert(played.line_clear() == 1);
+
+    mpe::field built;
+    for (int x = 4; x < built.width; ++x)
+        built.fill(x, 0);
+
+    assert(played.rows == built.rows);
+    assert(played.hash == built.hash);
+}
+
+///
+// Filling a cell updates the hash and dirty rows once, however often it is
+// filled
+void t5()
+{
+    mpe::field field;
+    field.dirty_rows = 0;
+
+    field.fill(2, 3);
+    const uint64_t once = field.hash;
+    assert(once == mpe::field::zobrist(2, 3));
+    assert(field.dirty_rows == mpe::field::row_bit(3));
+
+    field.fill(2, 3);
+    assert(field.hash == once);
+    assert(field.at(2, 3) == 1);
+}
+
+///
+// Node keys distinguish the hold and the queue position
+void t6()
+{
+    const mpe::field field;
+
+    assert(node_key(field, -1, 0) != node_key(field, 0, 0));
+    assert(node_key(field, -1, 0) != node_key(field, -1, 1));
+    assert(node_key(field, 2, 3) == node_key(field, 2, 3));
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+    t4();
+    t5();
+    t6();
+}
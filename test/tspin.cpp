@@ -0,0 +1,98 @@
+///
+// tspin.cpp
+//
+// Tests for T-spin detection with the 3-corner rule on hand-built fields.
+
+#include <cassert>
+
+#include "mpe/block.hpp"
+#include "mpe/field.hpp"
+#include "mpe/tspin.hpp"
+
+using namespace mpe;
+
+// Block ids, in the order used by the randomizer
+static constexpr block_type c_t = 1;
+static constexpr block_type c_s = 4;
+
+// Fill the cells of row y outside of the columns [from, to].
+static void fill_except(field &field, const int y, const int from,
+                        const int to)
+{
+    for (int x = 0; x < field.width; ++x) {
+        if (x < from || x > to)
+            field.fill(x, y);
+    }
+}
+
+// Return a T block at the given position and rotation.
+static block t_block(const int x, const int y, const rotation_type r)
+{
+    block b(c_t, r);
+    b.x = x;
+    b.y = y;
+    return b;
+}
+
+///
+// A T pointing down into a slot under an overhang is a T-spin double
+void t1()
+{
+    field field;
+    fill_except(field, 0, 4, 4);
+    fill_except(field, 1, 3, 5);
+    field.fill(3, 2);
+
+    const block b = t_block(3, 2, 2);
+    assert(detect_tspin(field, b, true) == spin_full);
+
+    field.place_block(b);
+    assert(field.line_clear() == 2);
+}
+
+///
+// A T against the wall with one of its front corners open is a mini
+void t2()
+{
+    field field;
+    field.fill(1, 0);
+
+    // Pointing right, with both back corners in the left wall
+    const block b = t_block(-1, 2, 1);
+    assert(detect_tspin(field, b, true) == spin_mini);
+
+    // The final kick test always counts as a full spin
+    block kicked = b;
+    kicked.kick = c_tspin_kick;
+    assert(detect_tspin(field, kicked, true) == spin_full);
+}
+
+///
+// Spins need a rotation as the last move, a T block and three corners
+void t3()
+{
+    field field;
+    fill_except(field, 0, 4, 4);
+    fill_except(field, 1, 3, 5);
+    field.fill(3, 2);
+
+    assert(detect_tspin(field, t_block(3, 2, 2), false) == spin_none);
+
+    block s(c_s, 2);
+    s.x = 3;
+    s.y = 2;
+    assert(detect_tspin(field, s, true) == spin_none);
+
+    // Without the overhang only the two corners in the stack are filled
+    mpe::field open;
+    fill_except(open, 0, 4, 4);
+    fill_except(open, 1, 3, 5);
+    assert(detect_tspin(open, t_block(3, 2, 2), true) == spin_none);
+}
+
+int main(void)
+{
+    t1();
+    t2();
+    t3();
+}